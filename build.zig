@@ -22,6 +22,8 @@ const debug_flags = &[_][]const u8{
     "-fPIC",
     "-DWERMS_DEBUG",
     "-DTHELIB_DEBUG",
+    // fill out physics::stats() every step
+    "-DCROSSWIRE_PHYSICS_STATS",
     "-std=c++20",
     // enable exceptions in debug mode
     "-DFMT_HEADER_ONLY",
@@ -70,16 +72,46 @@ const cpp_sources = &[_][]const u8{
     "src/allo/stack_allocator.cpp",
     "src/render_pipeline.cpp",
     "src/bullet.cpp",
+    "src/bullet_kernels.cpp",
+    "src/bullet_renderer.cpp",
     "src/main.cpp",
     "src/globals.cpp",
     "src/input.cpp",
     "src/physics.cpp",
+    "src/physics_memory.cpp",
     "src/player.cpp",
     "src/terrain.cpp",
     "src/resources.cpp",
     "src/build_site.cpp",
     "src/wire.cpp",
     "src/level_loader.cpp",
+    "src/timer.cpp",
+    "src/world.cpp",
+};
+
+/// Sources for crosswire_headless, which runs the simulation without opening a
+/// window. Nothing here may draw, read input, or load textures at runtime.
+const headless_sources = &[_][]const u8{
+    "src/thelib/body.cpp",
+    "src/thelib/shape.cpp",
+    "src/thelib/space.cpp",
+    "src/thelib/vect.cpp",
+    "src/natural_log/natural_log.cpp",
+    "src/allo/c_allocator.cpp",
+    "src/allo/random_allocation_registry.cpp",
+    "src/allo/stack_allocator.cpp",
+    "src/bullet.cpp",
+    "src/bullet_kernels.cpp",
+    "src/physics.cpp",
+    "src/physics_memory.cpp",
+    "src/terrain.cpp",
+    "src/turret.cpp",
+    "src/turret_kernels.cpp",
+    "src/build_site.cpp",
+    "src/level_loader.cpp",
+    "src/timer.cpp",
+    "src/world.cpp",
+    "src/headless.cpp",
 };
 
 const include_dirs = &[_][]const u8{
@@ -95,6 +127,7 @@ const test_source_files = &[_][]const u8{
     "stack_allocator_t/stack_allocator_t.cpp",
     "slice_t/slice_t.cpp",
     "pool_allocator_generational_t/pool_allocator_generational_t.cpp",
+    "physics/physics.cpp",
 };
 
 const Library = struct {
@@ -152,6 +185,19 @@ pub fn build(b: *std.Build) !void {
         .optimize = mode,
         .use_doubles = false,
     });
+    // route chipmunk's internal allocations through src/physics_memory.cpp.
+    // the statement expressions declare the hooks, since chipmunk's sources
+    // don't include any of our headers
+    {
+        const hooks = [_][2][]const u8{
+            .{ "cpcalloc", "({ extern void *cw_physics_calloc(size_t, size_t); cw_physics_calloc; })" },
+            .{ "cprealloc", "({ extern void *cw_physics_realloc(void *, size_t); cw_physics_realloc; })" },
+            .{ "cpfree", "({ extern void cw_physics_free(void *); cw_physics_free; })" },
+        };
+        for (hooks) |hook| {
+            chipmunk.artifact().defineCMacro(hook[0], hook[1]);
+        }
+    }
 
     // dont pass any build options to fmt
     fmt = b.dependency("fmt", .{});
@@ -210,6 +256,34 @@ pub fn build(b: *std.Build) !void {
             const all_sources_owned = cpp_sources;
             exe.addCSourceFiles(all_sources_owned, flags_owned);
             tests_lib.addCSourceFiles(all_sources_owned, flags_owned);
+
+            // headless simulation, for benchmarks and machines without a
+            // display. only uses raylib's headers (for Color and such), and
+            // CROSSWIRE_HEADLESS compiles out the few calls into raylib
+            {
+                var headless = b.addExecutable(.{
+                    .name = app_name ++ "_headless",
+                    .optimize = mode,
+                    .target = target,
+                });
+                var headless_flags = std.ArrayList([]const u8).init(b.allocator);
+                try headless_flags.appendSlice(flags_owned);
+                try headless_flags.append("-DCROSSWIRE_HEADLESS");
+                headless.addCSourceFiles(headless_sources, try headless_flags.toOwnedSlice());
+                headless.addIncludePath(.{ .path = raylib.imported.?.builder.pathFromRoot("src") });
+                linkSimulationLibrariesFor(headless);
+                b.installArtifact(headless);
+                try targets.append(headless);
+
+                // zig build headless -- [ticks] [level]
+                const run_cmd = b.addRunArtifact(headless);
+                run_cmd.step.dependOn(b.getInstallStep());
+                if (b.args) |args| {
+                    run_cmd.addArgs(args);
+                }
+                const headless_step = b.step("headless", "Run the simulation without a window and print timings");
+                headless_step.dependOn(&run_cmd.step);
+            }
             // set up tests (executables which dont link artefacts built from
             // all_sources_owned but they do need flags, so we do it in this
             // scope so we can have flags_owned)
@@ -286,6 +360,11 @@ pub fn build(b: *std.Build) !void {
 
 fn linkLibrariesFor(c: *std.Build.Step.Compile) void {
     c.linkLibrary(raylib.artifact());
+    linkSimulationLibrariesFor(c);
+}
+
+// everything except raylib, for targets which never open a window
+fn linkSimulationLibrariesFor(c: *std.Build.Step.Compile) void {
     c.linkLibrary(chipmunk.artifact());
     c.linkLibCpp();
     {
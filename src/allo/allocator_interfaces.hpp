@@ -31,6 +31,7 @@ enum class AllocationType
     Bullets,
     Physics,
     Turret,
+    Timers,
 
     /// maximum enum value, also should never be used
     Max,
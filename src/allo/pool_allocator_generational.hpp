@@ -489,6 +489,19 @@ requires(
         return capacity() - size();
     }
 
+    /// Make sure that at least the given number of items can be allocated
+    /// without reallocating. Grows by at least the reallocation ratio, so
+    /// reserving a few spots at a time doesn't reallocate every time.
+    inline lib::status_t<alloc_err_code_e>
+    reserve(size_t spots) TESTING_NOEXCEPT
+        requires(passed_options.reallocating)
+    {
+        if (m_spots_free >= spots)
+            return alloc_err_code_e::Okay;
+        const size_t needed = size() + spots;
+        return grow_to(std::max(needed, grown_capacity()));
+    }
+
   private:
     /// Return a mutable reference to an item pointed at by a handle, or an err
     /// code as to why the handle was invalid. used by both free() and get()
@@ -536,17 +549,22 @@ requires(
         return m_items_buffer.data()[index];
     }
 
-    /// Increases the size of the allocated buffer by the allocation ratio.
+    /// The capacity after growing by the reallocation ratio
+    [[nodiscard]] inline size_t grown_capacity() TESTING_NOEXCEPT
+    {
+        return std::ceil(static_cast<float>(capacity()) *
+                         passed_options.reallocation_ratio);
+    }
+
+    /// Increases the size of the allocated buffer to new_bufsize items.
     /// Leaves new memory uninitialized. Returns the number of new items alloced
     template <typename U>
     inline lib::result_t<size_t, alloc_err_code_e>
-    realloc_buffer(lib::slice_t<U> &buffer) TESTING_NOEXCEPT
+    realloc_buffer(lib::slice_t<U> &buffer, size_t new_bufsize) TESTING_NOEXCEPT
         requires(passed_options.reallocating)
     {
         const size_t bufsize = buffer.size();
         const size_t bufsize_bytes = buffer.size() * sizeof(U);
-        const size_t new_bufsize = std::ceil(static_cast<float>(bufsize) *
-                                             passed_options.reallocation_ratio);
         const size_t new_bufsize_bytes = new_bufsize * sizeof(U);
         assert(new_bufsize > bufsize);
 
@@ -572,25 +590,35 @@ requires(
         requires(passed_options.reallocating)
     {
         assert(m_spots_free == 0);
+        return grow_to(grown_capacity());
+    }
+
+    /// Grow all buffers to hold new_capacity items and put the new spots at
+    /// the front of the free list.
+    inline lib::status_t<alloc_err_code_e>
+    grow_to(size_t new_capacity) TESTING_NOEXCEPT
+        requires(passed_options.reallocating)
+    {
         // increase size of buffers but leave new memory uninitialized
         const auto original_buffer_size = m_items_buffer.size();
         assert(m_items_buffer.size() == m_activity_buffer.size() &&
                m_activity_buffer.size() == m_generation_buffer.size());
-        auto res_items = realloc_buffer(m_items_buffer);
+        auto res_items = realloc_buffer(m_items_buffer, new_capacity);
         if (!res_items.okay()) [[unlikely]]
             return res_items.status();
         const size_t new_items = res_items.release();
-        auto res_activity_bools = realloc_buffer(m_activity_buffer);
+        auto res_activity_bools =
+            realloc_buffer(m_activity_buffer, new_capacity);
         if (!res_activity_bools.okay()) [[unlikely]]
             return res_activity_bools.status();
         const size_t new_activity_bools = res_activity_bools.release();
-        auto res_generations = realloc_buffer(m_generation_buffer);
+        auto res_generations =
+            realloc_buffer(m_generation_buffer, new_capacity);
         if (!res_generations.okay()) [[unlikely]]
             return res_generations.status();
         const size_t new_generations = res_generations.release();
         assert(new_activity_bools == new_generations &&
                new_generations == new_items);
-        m_spots_free += new_items;
 
         index_t index = original_buffer_size;
         for (payload_t &item : lib::slice_t<payload_t>(
@@ -599,6 +627,12 @@ requires(
             ++index;
             item.index = index;
         }
+        // the last new spot continues on to whatever was free before
+        if (m_spots_free > 0) {
+            m_items_buffer.data()[m_items_buffer.size() - 1].index =
+                m_last_free_index;
+        }
+        m_spots_free += new_items;
         // set all new activity bools to false
         std::memset(m_activity_buffer.data() + original_buffer_size, false,
                     new_items);
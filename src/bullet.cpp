@@ -1,15 +1,118 @@
 #include "bullet.hpp"
+#include "bullet_kernels.hpp"
+#include "level_loader.hpp"
+#include "world.hpp"
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <vector>
 
 constexpr size_t initial_bullet_reservation = 100;
+constexpr size_t initial_particle_reservation = 4096;
 
 namespace cw::bullet {
 
-static lib::opt_t<bullet_allocator> bullets;
+/// Where a particle handle points. While the slot is in use, dense_index is the
+/// particle's position in the arrays of particle_storage_t. While it's free,
+/// dense_index is the next free slot.
+struct particle_slot_t
+{
+    uint32_t dense_index;
+    uint32_t generation;
+};
+
+constexpr uint32_t no_free_slot = UINT32_MAX;
+
+/// The particle grid never has more cells than this, so clearing it each
+/// update stays cheap even on huge levels
+constexpr size_t max_particle_grid_cells = size_t(1) << 16;
+
+/// Uniform grid over the level bounds, rebuilt from scratch at the end of
+/// every update_particles() with a two pass counting sort. Particles outside of
+/// the level are put in the nearest edge cell. Positions and handles are copied
+/// in cell order, so a query only touches contiguous memory.
+struct particle_grid_t
+{
+    /// The level bounds the cells were laid out for
+    lib::opt_t<cpBB> level_bounds;
+    cpBB bounds{0, 0, 0, 0};
+    float inverse_cell_size = 0;
+    uint32_t columns = 1;
+    uint32_t rows = 1;
+    /// The particles in cell c are entries cell_start[c] to cell_start[c + 1]
+    /// of x, y, and handle
+    std::vector<uint32_t> cell_start;
+    /// Cell of each particle by dense index, from the first pass of the sort
+    std::vector<uint32_t> cell_of;
+    std::vector<float> x;
+    std::vector<float> y;
+    std::vector<raw_particle_t> handle;
+};
+
+/// Particles are kept packed at the front of each array, so update_particles()
+/// never skips over dead ones. Destroying a particle moves the last one into
+/// its place, and the slots keep handles pointing at the right element.
+struct particle_storage_t
+{
+    std::vector<float> x;
+    std::vector<float> y;
+    std::vector<float> vx;
+    std::vector<float> vy;
+    std::vector<float> time_left;
+    std::vector<void *> user_data;
+    std::vector<raw_particle_t> handle;
+
+    std::vector<particle_slot_t> slots;
+    uint32_t first_free_slot = no_free_slot;
+
+    std::vector<particle_hit_t> hits;
+    /// Dense indices of particles that hit something this update
+    std::vector<uint32_t> to_destroy;
+    /// Scratch space for update_particles()
+    std::vector<float> next_x;
+    std::vector<float> next_y;
+
+    particle_grid_t grid;
+};
+
+/// The physics objects of a bullet which was destroyed, waiting for the next
+/// bullet spawned. The body is disabled, see physics::disable().
+struct recycled_bullet_t
+{
+    physics::raw_body_t body;
+    physics::raw_poly_shape_t shape;
+};
+
+struct world_state_t
+{
+    lib::opt_t<bullet_allocator> bullets;
+    /// Taken from the back, so the most recently disabled bodies get reused
+    /// first
+    std::vector<recycled_bullet_t> recycled;
+    /// Scratch space for update()
+    std::vector<raw_bullet_t> to_despawn;
+    /// Returned by spawn_batch()
+    std::vector<raw_bullet_t> spawned;
+    particle_storage_t particles;
+};
+
+static world_state_t &state() noexcept
+{
+    return expect_world_state(current_world().bullet, "bullet");
+}
 
 bullet_t::~bullet_t() noexcept
 {
-    physics::delete_body(body);
-    physics::delete_polygon_shape(shape);
+    auto &recycled = state().recycled;
+    if (recycled.size() >= max_recycled_bullets) {
+        physics::delete_body(body);
+        physics::delete_polygon_shape(shape);
+        return;
+    }
+    // the next bullet to use this body may not have user data
+    physics::clear_user_data(body);
+    physics::disable(body);
+    recycled.push_back(recycled_bullet_t{.body = body, .shape = shape});
 }
 
 lib::vect_t bullet_t::position() const noexcept
@@ -22,31 +125,95 @@ lib::opt_t<void *> bullet_t::user_data() const noexcept
     return physics::get_user_data(body);
 }
 
-/// Do not use this constructor unless you know what you're doing
-bullet_t::bullet_t(const bullet_creation_options_t &options) noexcept
-    : body(physics::create_body(game_id_e::Bullet,
+/// The body for a new bullet: the most recently recycled one if there is one,
+/// which stays on the recycled list until take_shape() picks up its shape
+static physics::raw_body_t take_body() noexcept
+{
+    auto &recycled = state().recycled;
+    if (!recycled.empty())
+        return recycled.back().body;
+    return physics::create_body(game_id_e::Bullet,
                                 lib::body_t::body_options_t{
                                     .type = lib::body_t::Type::DYNAMIC,
                                     .mass = global_mass,
                                     .moment = INFINITY,
-                                })),
-      shape(physics::create_box_shape(body, global_square_hitbox_options))
+                                });
+}
+
+/// The shape for a body returned by take_body()
+static physics::raw_poly_shape_t take_shape(physics::raw_body_t body) noexcept
+{
+    auto &recycled = state().recycled;
+    if (!recycled.empty() && recycled.back().body == body) {
+        const physics::raw_poly_shape_t shape = recycled.back().shape;
+        recycled.pop_back();
+        return shape;
+    }
+    const auto shape = physics::create_box_shape(body,
+                                                 global_square_hitbox_options);
+    // set the id of the shape to be bullet, for good measure
+    auto &shape_actual = physics::get_polygon_shape(shape);
+    set_physics_id(*shape_actual.parent_cast(), game_id_e::Bullet);
+    return shape;
+}
+
+/// Do not use this constructor unless you know what you're doing
+bullet_t::bullet_t(const bullet_creation_options_t &options) noexcept
+    : body(take_body()), shape(take_shape(body)), time_left(options.lifetime)
 {
+    if (physics::is_disabled(body)) {
+        physics::enable(body, options.position, options.initial_velocity);
+        return;
+    }
     lib::body_t &actual = physics::get_body(body);
     actual.set_position(options.position);
     actual.set_velocity(options.initial_velocity);
+}
 
-    // set the id of the shape to be bullet, for good measure
-    auto &shape_actual = physics::get_polygon_shape(shape);
-    set_physics_id(*shape_actual.parent_cast(), game_id_e::Bullet);
+void init() noexcept
+{
+    current_world().bullet = create_world_state<world_state_t>();
+    state().bullets.emplace(initial_bullet_reservation);
+    state().recycled.reserve(max_recycled_bullets);
+    state().to_despawn.reserve(initial_bullet_reservation);
+    state().spawned.reserve(initial_bullet_reservation);
+
+    auto &particles = state().particles;
+    particles.x.reserve(initial_particle_reservation);
+    particles.y.reserve(initial_particle_reservation);
+    particles.vx.reserve(initial_particle_reservation);
+    particles.vy.reserve(initial_particle_reservation);
+    particles.time_left.reserve(initial_particle_reservation);
+    particles.user_data.reserve(initial_particle_reservation);
+    particles.handle.reserve(initial_particle_reservation);
+    particles.slots.reserve(initial_particle_reservation);
+    particles.hits.reserve(initial_particle_reservation);
+    particles.to_destroy.reserve(initial_particle_reservation);
+    particles.next_x.reserve(initial_particle_reservation);
+    particles.next_y.reserve(initial_particle_reservation);
+    particles.grid.cell_of.reserve(initial_particle_reservation);
+    particles.grid.x.reserve(initial_particle_reservation);
+    particles.grid.y.reserve(initial_particle_reservation);
+    particles.grid.handle.reserve(initial_particle_reservation);
+    particles.grid.cell_start.assign(2, 0);
 }
 
-void init() noexcept { bullets.emplace(initial_bullet_reservation); }
-void cleanup() noexcept { bullets.reset(); }
+void cleanup() noexcept
+{
+    // bullets delete their physics bodies when destroyed, so this has to
+    // happen before physics::cleanup(). destroying them fills up the recycled
+    // list, so they go first.
+    state().bullets.reset();
+    for (const recycled_bullet_t &recycled : state().recycled) {
+        physics::delete_body(recycled.body);
+        physics::delete_polygon_shape(recycled.shape);
+    }
+    destroy_world_state(current_world().bullet);
+}
 
 raw_bullet_t spawn(const bullet_creation_options_t &options) noexcept
 {
-    auto maybe_spawned = bullets.value().alloc_new(options);
+    auto maybe_spawned = state().bullets.value().alloc_new(options);
 
     if (maybe_spawned.okay())
         return maybe_spawned.release();
@@ -66,7 +233,7 @@ raw_bullet_t spawn(const bullet_creation_options_t &options,
                    void *user_data) noexcept
 {
     auto handle = spawn(options);
-    auto res = bullets.value().get(handle);
+    auto res = state().bullets.value().get(handle);
     if (!res.okay()) {
         LN_FATAL("A bullet that was literally just successfully allocated "
                  "failed when passed to bullets.get(). Aborting. How does that "
@@ -81,9 +248,46 @@ raw_bullet_t spawn(const bullet_creation_options_t &options,
     return handle;
 }
 
+lib::slice_t<const raw_bullet_t>
+spawn_batch(lib::slice_t<const bullet_creation_options_t> options,
+            void *user_data) noexcept
+{
+    auto &bullets = state().bullets.value();
+    auto &spawned = state().spawned;
+    spawned.clear();
+    const size_t count = options.size();
+
+    if (!bullets.reserve(count).okay()) [[unlikely]] {
+        LN_FATAL_FMT("Got OOM when trying to reserve space for {} bullets",
+                     count);
+        std::abort();
+    }
+    // each bullet is one body and one box shape
+    physics::reserve(count, count);
+
+    physics::begin_batch();
+    for (const bullet_creation_options_t &option : options) {
+        auto res = bullets.alloc_new(option);
+        if (!res.okay()) [[unlikely]] {
+            LN_FATAL("Failed to allocate bullet after reserving space for it");
+            std::abort();
+        }
+        const raw_bullet_t handle = res.release();
+        if (user_data) {
+            auto &bullet = bullets.get(handle).release();
+            physics::set_user_data_and_id(bullet.body, game_id_e::Bullet,
+                                          user_data);
+        }
+        spawned.push_back(handle);
+    }
+    physics::end_batch();
+
+    return spawned;
+}
+
 lib::opt_t<bullet_t &> try_get(raw_bullet_t handle) noexcept
 {
-    auto res = bullets.value().get(handle);
+    auto res = state().bullets.value().get(handle);
     if (!res.okay())
         // discard the status code, just turn it into an optional
         return {};
@@ -93,7 +297,84 @@ lib::opt_t<bullet_t &> try_get(raw_bullet_t handle) noexcept
 
 bool try_destroy(raw_bullet_t handle) noexcept
 {
-    return bullets.value().free(handle).okay();
+    return state().bullets.value().free(handle).okay();
+}
+
+/// The level bounds plus bullet_bounds_margin, or nothing if there's no level
+static lib::opt_t<cpBB> culling_bounds() noexcept
+{
+    auto bounds = loader::level_bounds();
+    if (!bounds)
+        return {};
+    cpBB &box = bounds.value();
+    box.l -= bullet_bounds_margin;
+    box.b -= bullet_bounds_margin;
+    box.r += bullet_bounds_margin;
+    box.t += bullet_bounds_margin;
+    return bounds;
+}
+
+static bool contains(const cpBB &box, lib::vect_t point) noexcept
+{
+    return point.x >= box.l && point.x <= box.r && point.y >= box.b &&
+           point.y <= box.t;
+}
+
+/// The fraction along the segment from start to end where it enters box, or
+/// INFINITY if it never does. Zero if start is already inside.
+static float sweep_box(lib::vect_t start, lib::vect_t end,
+                       const cpBB &box) noexcept
+{
+    const std::array<float, 2> origin{start.x, start.y};
+    const std::array<float, 2> delta{end.x - start.x, end.y - start.y};
+    const std::array<float, 2> low{float(box.l), float(box.b)};
+    const std::array<float, 2> high{float(box.r), float(box.t)};
+    float enter = 0;
+    float exit = 1;
+    for (size_t axis = 0; axis < 2; ++axis) {
+        if (delta[axis] == 0) {
+            if (origin[axis] < low[axis] || origin[axis] > high[axis])
+                return INFINITY;
+            continue;
+        }
+        float near = (low[axis] - origin[axis]) / delta[axis];
+        float far = (high[axis] - origin[axis]) / delta[axis];
+        if (near > far)
+            std::swap(near, far);
+        enter = std::max(enter, near);
+        exit = std::min(exit, far);
+        if (enter > exit)
+            return INFINITY;
+    }
+    return enter;
+}
+
+void update(float timestep) noexcept
+{
+    auto &bullets = state().bullets.value();
+    auto &to_despawn = state().to_despawn;
+    to_despawn.clear();
+    auto bounds = culling_bounds();
+
+    for (bullet_t &bullet : bullets) {
+        bullet.time_left -= timestep;
+        if (bullet.time_left > 0 &&
+            (!bounds || contains(bounds.value(), bullet.position())))
+            continue;
+        auto handle = bullets.get_handle_from_item(&bullet);
+        if (!handle.okay()) [[unlikely]] {
+            LN_WARN("Failed to get handle for bullet while culling");
+            continue;
+        }
+        to_despawn.push_back(handle.release());
+    }
+
+    // freeing while iterating the pool isn't safe, so it happens afterwards
+    physics::begin_batch();
+    for (const raw_bullet_t &handle : to_despawn) {
+        bullets.free(handle);
+    }
+    physics::end_batch();
 }
 
 bool is_body_bullet(cpBody &maybe_bullet)
@@ -103,4 +384,336 @@ bool is_body_bullet(cpBody &maybe_bullet)
     }
     return false;
 }
+
+/// Get the dense index of a particle, or nothing if the handle is stale
+static lib::opt_t<uint32_t> dense_index_of(const particle_storage_t &particles,
+                                           raw_particle_t handle) noexcept
+{
+    if (handle.index >= particles.slots.size())
+        return {};
+    const particle_slot_t &slot = particles.slots[handle.index];
+    if (slot.generation != handle.generation)
+        return {};
+    return slot.dense_index;
+}
+
+/// Swap the last particle into the given dense index and shrink the arrays
+static void remove_particle(particle_storage_t &particles,
+                            uint32_t dense_index) noexcept
+{
+    const uint32_t last = uint32_t(particles.x.size() - 1);
+    const raw_particle_t removed = particles.handle[dense_index];
+
+    if (dense_index != last) {
+        particles.x[dense_index] = particles.x[last];
+        particles.y[dense_index] = particles.y[last];
+        particles.vx[dense_index] = particles.vx[last];
+        particles.vy[dense_index] = particles.vy[last];
+        particles.time_left[dense_index] = particles.time_left[last];
+        particles.user_data[dense_index] = particles.user_data[last];
+        particles.handle[dense_index] = particles.handle[last];
+        particles.slots[particles.handle[dense_index].index].dense_index =
+            dense_index;
+    }
+    particles.x.pop_back();
+    particles.y.pop_back();
+    particles.vx.pop_back();
+    particles.vy.pop_back();
+    particles.time_left.pop_back();
+    particles.user_data.pop_back();
+    particles.handle.pop_back();
+
+    // bumping the generation invalidates any handles to the removed particle
+    particle_slot_t &slot = particles.slots[removed.index];
+    ++slot.generation;
+    slot.dense_index = particles.first_free_slot;
+    particles.first_free_slot = removed.index;
+}
+
+raw_particle_t spawn_particle(const bullet_creation_options_t &options,
+                              void *user_data) noexcept
+{
+    auto &particles = state().particles;
+
+    uint32_t slot_index;
+    if (particles.first_free_slot != no_free_slot) {
+        slot_index = particles.first_free_slot;
+        particles.first_free_slot = particles.slots[slot_index].dense_index;
+    } else {
+        if (particles.slots.size() >= no_free_slot) [[unlikely]] {
+            LN_FATAL("Ran out of particle handles");
+            std::abort();
+        }
+        slot_index = uint32_t(particles.slots.size());
+        particles.slots.push_back({.dense_index = 0, .generation = 0});
+    }
+
+    particle_slot_t &slot = particles.slots[slot_index];
+    slot.dense_index = uint32_t(particles.x.size());
+    const raw_particle_t handle{
+        .index = slot_index,
+        .generation = slot.generation,
+    };
+
+    particles.x.push_back(options.position.x);
+    particles.y.push_back(options.position.y);
+    particles.vx.push_back(options.initial_velocity.x);
+    particles.vy.push_back(options.initial_velocity.y);
+    particles.time_left.push_back(options.lifetime);
+    particles.user_data.push_back(user_data);
+    particles.handle.push_back(handle);
+    return handle;
+}
+
+bool try_destroy(raw_particle_t handle) noexcept
+{
+    auto &particles = state().particles;
+    auto dense_index = dense_index_of(particles, handle);
+    if (!dense_index)
+        return false;
+    remove_particle(particles, dense_index.value());
+    return true;
+}
+
+lib::opt_t<lib::vect_t> try_get_position(raw_particle_t handle) noexcept
+{
+    const auto &particles = state().particles;
+    auto dense_index = dense_index_of(particles, handle);
+    if (!dense_index)
+        return {};
+    return lib::vect_t{particles.x[dense_index.value()],
+                       particles.y[dense_index.value()]};
+}
+
+static bool same_bounds(lib::opt_t<cpBB> a, lib::opt_t<cpBB> b) noexcept
+{
+    if (a.has_value() != b.has_value())
+        return false;
+    if (!a.has_value())
+        return true;
+    const cpBB &x = a.value();
+    const cpBB &y = b.value();
+    return x.l == y.l && x.b == y.b && x.r == y.r && x.t == y.t;
+}
+
+/// Lay out the cells of the grid to cover the given level bounds. Without a
+/// level there's a single cell containing everything.
+static void configure_grid(particle_grid_t &grid,
+                           lib::opt_t<cpBB> level_bounds) noexcept
+{
+    grid.level_bounds = level_bounds;
+    grid.columns = 1;
+    grid.rows = 1;
+    grid.inverse_cell_size = 0;
+    if (level_bounds) {
+        grid.bounds = level_bounds.value();
+        const float width = float(grid.bounds.r - grid.bounds.l);
+        const float height = float(grid.bounds.t - grid.bounds.b);
+        float cell_size = particle_grid_cell_size;
+        const float cells = std::ceil(width / cell_size) *
+                            std::ceil(height / cell_size);
+        if (cells > float(max_particle_grid_cells)) {
+            cell_size *= std::sqrt(cells / float(max_particle_grid_cells));
+        }
+        grid.inverse_cell_size = 1.0f / cell_size;
+        grid.columns = std::max(1u, uint32_t(std::ceil(width / cell_size)));
+        grid.rows = std::max(1u, uint32_t(std::ceil(height / cell_size)));
+        // rounding up each side can push it a little over the limit
+        while (size_t(grid.columns) * grid.rows > max_particle_grid_cells) {
+            grid.columns = std::max(1u, grid.columns - 1);
+            grid.rows = std::max(1u, grid.rows - 1);
+        }
+    }
+    grid.cell_start.assign(size_t(grid.columns) * grid.rows + 1, 0);
+}
+
+static uint32_t grid_column(const particle_grid_t &grid, float x) noexcept
+{
+    const float column = (x - float(grid.bounds.l)) * grid.inverse_cell_size;
+    return uint32_t(std::clamp(column, 0.0f, float(grid.columns - 1)));
+}
+
+static uint32_t grid_row(const particle_grid_t &grid, float y) noexcept
+{
+    const float row = (y - float(grid.bounds.b)) * grid.inverse_cell_size;
+    return uint32_t(std::clamp(row, 0.0f, float(grid.rows - 1)));
+}
+
+static void rebuild_grid(particle_storage_t &particles) noexcept
+{
+    auto &grid = particles.grid;
+    const auto level_bounds = loader::level_bounds();
+    if (!same_bounds(grid.level_bounds, level_bounds)) {
+        configure_grid(grid, level_bounds);
+    }
+
+    const size_t count = particles.x.size();
+    const size_t cells = size_t(grid.columns) * grid.rows;
+    std::fill(grid.cell_start.begin(), grid.cell_start.end(), 0);
+    grid.cell_of.resize(count);
+    grid.x.resize(count);
+    grid.y.resize(count);
+    grid.handle.resize(count);
+
+    // first pass: count the particles in each cell, offset by one so that the
+    // prefix sum gives the start of each cell
+    for (size_t i = 0; i < count; ++i) {
+        const uint32_t cell =
+            grid_row(grid, particles.y[i]) * grid.columns +
+            grid_column(grid, particles.x[i]);
+        grid.cell_of[i] = cell;
+        ++grid.cell_start[cell + 1];
+    }
+    for (size_t cell = 1; cell <= cells; ++cell) {
+        grid.cell_start[cell] += grid.cell_start[cell - 1];
+    }
+
+    // second pass: scatter, using the start of each cell as its write cursor.
+    // afterwards each cursor has moved to the start of the next cell.
+    for (size_t i = 0; i < count; ++i) {
+        const uint32_t slot = grid.cell_start[grid.cell_of[i]]++;
+        grid.x[slot] = particles.x[i];
+        grid.y[slot] = particles.y[i];
+        grid.handle[slot] = particles.handle[i];
+    }
+    for (size_t cell = cells; cell > 0; --cell) {
+        grid.cell_start[cell] = grid.cell_start[cell - 1];
+    }
+    grid.cell_start[0] = 0;
+}
+
+void update_particles(float timestep,
+                      lib::opt_t<lib::rect_t> player_hitbox) noexcept
+{
+    auto &particles = state().particles;
+    particles.hits.clear();
+    particles.to_destroy.clear();
+
+    const size_t count = particles.x.size();
+    particles.next_x.resize(count);
+    particles.next_y.resize(count);
+    kernels::integrate(particles.x, particles.y, particles.vx, particles.vy,
+                       timestep, particles.next_x, particles.next_y);
+
+    // grown by the particle's radius, to match the segment query
+    const bool has_player = player_hitbox.has_value();
+    cpBB player_bounds{};
+    if (has_player) {
+        player_bounds = player_hitbox.value();
+        player_bounds.l -= particle_radius;
+        player_bounds.b -= particle_radius;
+        player_bounds.r += particle_radius;
+        player_bounds.t += particle_radius;
+    }
+
+    for (float &time_left : particles.time_left) {
+        time_left -= timestep;
+    }
+    auto bounds = culling_bounds();
+
+    for (size_t i = 0; i < count; ++i) {
+        const lib::vect_t start{particles.x[i], particles.y[i]};
+        const lib::vect_t end{particles.next_x[i], particles.next_y[i]};
+
+        if (particles.time_left[i] <= 0 ||
+            (bounds && !contains(bounds.value(), end))) {
+            particles.to_destroy.push_back(uint32_t(i));
+            continue;
+        }
+
+        const float player_fraction =
+            has_player ? sweep_box(start, end, player_bounds) : INFINITY;
+        auto hit = physics::query_segment_first(start, end, particle_radius,
+                                                particle_collision_filter);
+
+        // the player only counts if it's reached before any terrain
+        if (player_fraction <= 1 &&
+            (!hit || player_fraction < hit.value().distance)) {
+            particles.hits.push_back(particle_hit_t{
+                .particle = particles.handle[i],
+                .user_data = particles.user_data[i],
+                .id = game_id_e::Player,
+                .point = start + ((end - start) * player_fraction),
+                .shape = nullptr,
+            });
+            particles.to_destroy.push_back(uint32_t(i));
+            continue;
+        }
+
+        if (hit) {
+            particles.hits.push_back(particle_hit_t{
+                .particle = particles.handle[i],
+                .user_data = particles.user_data[i],
+                .id = hit.value().id,
+                .point = hit.value().point,
+                .shape = hit.value().shape,
+            });
+            particles.to_destroy.push_back(uint32_t(i));
+        }
+    }
+
+    // particles that hit something are about to be removed, so it doesn't
+    // matter that they get moved too
+    particles.x.swap(particles.next_x);
+    particles.y.swap(particles.next_y);
+
+    // remove from the back so that the particles being swapped into the holes
+    // are never ones that also need to be removed
+    for (auto it = particles.to_destroy.rbegin();
+         it != particles.to_destroy.rend(); ++it) {
+        remove_particle(particles, *it);
+    }
+
+    rebuild_grid(particles);
+}
+
+lib::slice_t<raw_particle_t>
+query_particles(lib::vect_t point, float radius,
+                lib::slice_t<raw_particle_t> out) noexcept
+{
+    const auto &grid = state().particles.grid;
+    const float radius_sq = radius * radius;
+    const uint32_t first_column = grid_column(grid, point.x - radius);
+    const uint32_t last_column = grid_column(grid, point.x + radius);
+    const uint32_t first_row = grid_row(grid, point.y - radius);
+    const uint32_t last_row = grid_row(grid, point.y + radius);
+
+    size_t found = 0;
+    for (uint32_t row = first_row; row <= last_row; ++row) {
+        const uint32_t row_start = row * grid.columns;
+        // cells in a row are contiguous, so the whole span can be scanned in
+        // one go
+        const uint32_t begin = grid.cell_start[row_start + first_column];
+        const uint32_t end = grid.cell_start[row_start + last_column + 1];
+        for (uint32_t i = begin; i < end; ++i) {
+            const float dx = grid.x[i] - point.x;
+            const float dy = grid.y[i] - point.y;
+            if (dx * dx + dy * dy > radius_sq)
+                continue;
+            if (found == out.size())
+                return {out, 0, found};
+            out.data()[found++] = grid.handle[i];
+        }
+    }
+    return {out, 0, found};
+}
+
+lib::slice_t<const particle_hit_t> particle_hits() noexcept
+{
+    return state().particles.hits;
+}
+
+particle_view_t particles() noexcept
+{
+    const auto &particles = state().particles;
+    return particle_view_t{
+        .x = particles.x,
+        .y = particles.y,
+        .vx = particles.vx,
+        .vy = particles.vy,
+        .time_left = particles.time_left,
+        .user_data = particles.user_data,
+        .handle = particles.handle,
+    };
+}
 } // namespace cw::bullet
@@ -34,24 +34,41 @@ inline constexpr allo::pool_allocator_generational_options_t
         .reallocation_ratio = 1.5f,
     };
 
+/// How many seconds a bullet lives for if it doesn't hit anything
+inline constexpr float default_bullet_lifetime = 10;
+
+/// How far outside the level bounds a bullet can go before it's destroyed
+inline constexpr float bullet_bounds_margin = 64;
+
+/// How many dead bullets keep their physics body and shape around, disabled,
+/// to be reused by the next bullets spawned. Beyond this they are deleted.
+inline constexpr size_t max_recycled_bullets = 1024;
+
 // Options passed to bullet::spawn and bullet constructor
 struct bullet_creation_options_t
 {
     lib::vect_t position;
     lib::vect_t initial_velocity;
+    /// Seconds until the bullet is destroyed automatically
+    float lifetime = default_bullet_lifetime;
 };
 
 /// Data stored per-bullet
 struct bullet_t
 {
+    /// Disables the body and shape and keeps them for the next bullet, unless
+    /// max_recycled_bullets are already waiting to be reused
     ~bullet_t() noexcept;
     physics::raw_body_t body;
     physics::raw_poly_shape_t shape;
+    /// Seconds until update() destroys this bullet
+    float time_left;
     /// Get the position of this bullet
     [[nodiscard]] lib::vect_t position() const noexcept;
     [[nodiscard]] lib::opt_t<void *> user_data() const noexcept;
 
-    /// Do not use this constructor unless you know what you're doing
+    /// Do not use this constructor unless you know what you're doing. Reuses
+    /// the body and shape of a destroyed bullet if there is one.
     explicit bullet_t(const bullet_creation_options_t &) noexcept;
 };
 
@@ -65,7 +82,9 @@ using raw_bullet_t = bullet_allocator::handle_t;
 lib::opt_t<bullet_t &> try_get(raw_bullet_t handle) noexcept;
 
 /// Attempt to destroy the bullet pointed at by the handle. Returns true if
-/// successful, false if the handle didn't point to anything.
+/// successful, false if the handle didn't point to anything. Safe to call from
+/// inside a collision callback: the physics body and shape will be removed at
+/// the end of the step.
 bool try_destroy(raw_bullet_t handle) noexcept;
 
 /// Spawns a bullet and stores no data inside of it
@@ -77,6 +96,118 @@ raw_bullet_t spawn(const bullet_creation_options_t &options) noexcept;
 raw_bullet_t spawn(const bullet_creation_options_t &options,
                    void *user_data) noexcept;
 
+/// Spawn one bullet for each of the options, all with the same user data (which
+/// may be null). Pool space is reserved once up front and the physics bodies
+/// and shapes enter the space as one batch, already in position. Returns the
+/// handles in the same order as the options. The slice is only valid until the
+/// next call to spawn_batch().
+lib::slice_t<const raw_bullet_t>
+spawn_batch(lib::slice_t<const bullet_creation_options_t> options,
+            void *user_data) noexcept;
+
 /// Returns true if the body is a bullet and false if its something else.
 bool is_body_bullet(cpBody &maybe_bullet);
+
+/// Destroy every bullet which has outlived its lifetime or left the level
+/// bounds (plus bullet_bounds_margin), in one pass over the pool. Their physics
+/// bodies and shapes are removed from the space as one batch. Call once per
+/// fixed step, outside of physics::update().
+void update(float timestep) noexcept;
+
+// Particle bullets: a lighter alternative to the bullets above. They have no
+// physics body or shape, they're just positions and velocities stored as
+// structure-of-arrays and moved by update_particles(). Collision with terrain
+// is one segment query per particle from its old position to its new one, so
+// fast particles can't tunnel through thin terrain. Collision with the player
+// sweeps the same segment against the player's hitbox, and whichever of the
+// two is hit first along the segment is the one reported. Nothing can collide
+// with a particle, and particles don't collide with each other.
+
+/// Radius of the segment query used for particle collision, roughly the same
+/// size as the hitbox of a rigid body bullet
+inline constexpr float particle_radius = 5;
+
+/// The collision types that particles are stopped by, other than the player
+inline constexpr physics::query_filter_t particle_collision_filter =
+    physics::query_filter({physics::collision_type_e::Obstacle});
+
+/// Handle to a particle bullet. Stays valid until the particle is destroyed,
+/// even though the particle itself moves around in memory.
+struct raw_particle_t
+{
+    uint32_t index;
+    uint32_t generation;
+
+    constexpr bool operator==(const raw_particle_t &) const noexcept = default;
+};
+
+/// A particle that hit something during the last update_particles(). The
+/// particle has already been destroyed.
+struct particle_hit_t
+{
+    raw_particle_t particle;
+    void *user_data;
+    /// game_id_e::Player for hits against the player's hitbox, otherwise the
+    /// id of the terrain that was hit
+    game_id_e id;
+    /// Where the particle was when it hit
+    lib::vect_t point;
+    /// The terrain shape that was hit, or null for the player
+    lib::shape_t *shape;
+};
+
+/// Read-only view of every live particle. All slices have the same length and
+/// element i of each describes the same particle. Invalidated by spawning,
+/// destroying, or updating particles.
+struct particle_view_t
+{
+    lib::slice_t<const float> x;
+    lib::slice_t<const float> y;
+    lib::slice_t<const float> vx;
+    lib::slice_t<const float> vy;
+    /// Seconds until the particle is destroyed automatically
+    lib::slice_t<const float> time_left;
+    lib::slice_t<void *const> user_data;
+    lib::slice_t<const raw_particle_t> handle;
+};
+
+/// Spawn a particle bullet. The user data is given back in its particle_hit_t,
+/// the same lifetime rules as spawn(options, user_data) apply.
+raw_particle_t spawn_particle(const bullet_creation_options_t &options,
+                              void *user_data = nullptr) noexcept;
+
+/// Attempt to destroy a particle. Returns true if successful, false if the
+/// handle didn't point to anything.
+bool try_destroy(raw_particle_t handle) noexcept;
+
+/// Get the position of a particle if it still exists
+lib::opt_t<lib::vect_t> try_get_position(raw_particle_t handle) noexcept;
+
+/// Move every particle by its velocity and destroy the ones that hit something
+/// on the way, outlived their lifetime, or left the level bounds (plus
+/// bullet_bounds_margin). Only hits are reported in particle_hits(). Call once
+/// per fixed step, before physics::update(), so that particles are tested
+/// against the same positions that the step starts from. The player's hitbox
+/// is in the same format as a box shape's bounds, centered on the rect's
+/// position.
+void update_particles(float timestep,
+                      lib::opt_t<lib::rect_t> player_hitbox) noexcept;
+
+/// Particles that hit something during the last call to update_particles()
+[[nodiscard]] lib::slice_t<const particle_hit_t> particle_hits() noexcept;
+
+[[nodiscard]] particle_view_t particles() noexcept;
+
+/// Side length of the cells of the grid used by query_particles(). On very
+/// large levels the cells are made bigger to keep the number of cells bounded.
+inline constexpr float particle_grid_cell_size = 64;
+
+/// Find every particle within radius of point. Uses a grid which is rebuilt at
+/// the end of each update_particles(), so this sees particles where they were
+/// at that point: particles spawned since then are missing, and particles
+/// destroyed since then may still be returned. Writes into out and returns the
+/// part that was filled, extra hits are dropped.
+lib::slice_t<raw_particle_t>
+query_particles(lib::vect_t point, float radius,
+                lib::slice_t<raw_particle_t> out) noexcept;
 } // namespace cw::bullet
@@ -0,0 +1,212 @@
+#include "bullet_kernels.hpp"
+#include "natural_log/natural_log.hpp"
+#include <cstdlib>
+
+#if defined(__x86_64__) || defined(__i386__)
+#define CROSSWIRE_BULLET_KERNELS_X86
+#include <immintrin.h>
+#endif
+
+using integrate_fn = void (*)(const float *x, const float *y, const float *vx,
+                              const float *vy, float timestep, float *out_x,
+                              float *out_y, size_t count) noexcept;
+using overlap_box_fn = size_t (*)(const float *x, const float *y,
+                                  size_t count, const cpBB &box,
+                                  uint32_t *out) noexcept;
+
+static void integrate_scalar(const float *x, const float *y, const float *vx,
+                             const float *vy, float timestep, float *out_x,
+                             float *out_y, size_t count) noexcept
+{
+    for (size_t i = 0; i < count; ++i) {
+        out_x[i] = x[i] + vx[i] * timestep;
+        out_y[i] = y[i] + vy[i] * timestep;
+    }
+}
+
+static size_t overlap_box_scalar(const float *x, const float *y, size_t count,
+                                 const cpBB &box, uint32_t *out) noexcept
+{
+    size_t hits = 0;
+    for (size_t i = 0; i < count; ++i) {
+        const bool inside = x[i] >= box.l && x[i] <= box.r && y[i] >= box.b &&
+                            y[i] <= box.t;
+        // write unconditionally so there's no branch to mispredict
+        out[hits] = uint32_t(i);
+        hits += inside;
+    }
+    return hits;
+}
+
+#ifdef CROSSWIRE_BULLET_KERNELS_X86
+/// Append the index of every set bit in mask, offset by base, to out
+static size_t append_mask(uint32_t mask, size_t base, uint32_t *out) noexcept
+{
+    size_t hits = 0;
+    while (mask != 0) {
+        out[hits++] = uint32_t(base + size_t(__builtin_ctz(mask)));
+        mask &= mask - 1;
+    }
+    return hits;
+}
+
+__attribute__((target("sse2"))) static void
+integrate_sse2(const float *x, const float *y, const float *vx, const float *vy,
+               float timestep, float *out_x, float *out_y,
+               size_t count) noexcept
+{
+    const __m128 dt = _mm_set1_ps(timestep);
+    size_t i = 0;
+    for (; i + 4 <= count; i += 4) {
+        const __m128 new_x = _mm_add_ps(
+            _mm_loadu_ps(x + i), _mm_mul_ps(_mm_loadu_ps(vx + i), dt));
+        const __m128 new_y = _mm_add_ps(
+            _mm_loadu_ps(y + i), _mm_mul_ps(_mm_loadu_ps(vy + i), dt));
+        _mm_storeu_ps(out_x + i, new_x);
+        _mm_storeu_ps(out_y + i, new_y);
+    }
+    integrate_scalar(x + i, y + i, vx + i, vy + i, timestep, out_x + i,
+                     out_y + i, count - i);
+}
+
+__attribute__((target("sse2"))) static size_t
+overlap_box_sse2(const float *x, const float *y, size_t count, const cpBB &box,
+                 uint32_t *out) noexcept
+{
+    const __m128 left = _mm_set1_ps(float(box.l));
+    const __m128 right = _mm_set1_ps(float(box.r));
+    const __m128 bottom = _mm_set1_ps(float(box.b));
+    const __m128 top = _mm_set1_ps(float(box.t));
+    size_t hits = 0;
+    size_t i = 0;
+    for (; i + 4 <= count; i += 4) {
+        const __m128 px = _mm_loadu_ps(x + i);
+        const __m128 py = _mm_loadu_ps(y + i);
+        const __m128 inside =
+            _mm_and_ps(_mm_and_ps(_mm_cmpge_ps(px, left),
+                                  _mm_cmple_ps(px, right)),
+                       _mm_and_ps(_mm_cmpge_ps(py, bottom),
+                                  _mm_cmple_ps(py, top)));
+        hits += append_mask(uint32_t(_mm_movemask_ps(inside)), i, out + hits);
+    }
+    const size_t tail = overlap_box_scalar(x + i, y + i, count - i, box,
+                                           out + hits);
+    for (size_t j = 0; j < tail; ++j) {
+        out[hits + j] += uint32_t(i);
+    }
+    return hits + tail;
+}
+
+__attribute__((target("avx2"))) static void
+integrate_avx2(const float *x, const float *y, const float *vx, const float *vy,
+               float timestep, float *out_x, float *out_y,
+               size_t count) noexcept
+{
+    const __m256 dt = _mm256_set1_ps(timestep);
+    size_t i = 0;
+    for (; i + 8 <= count; i += 8) {
+        const __m256 new_x = _mm256_add_ps(
+            _mm256_loadu_ps(x + i), _mm256_mul_ps(_mm256_loadu_ps(vx + i), dt));
+        const __m256 new_y = _mm256_add_ps(
+            _mm256_loadu_ps(y + i), _mm256_mul_ps(_mm256_loadu_ps(vy + i), dt));
+        _mm256_storeu_ps(out_x + i, new_x);
+        _mm256_storeu_ps(out_y + i, new_y);
+    }
+    integrate_sse2(x + i, y + i, vx + i, vy + i, timestep, out_x + i, out_y + i,
+                   count - i);
+}
+
+__attribute__((target("avx2"))) static size_t
+overlap_box_avx2(const float *x, const float *y, size_t count, const cpBB &box,
+                 uint32_t *out) noexcept
+{
+    const __m256 left = _mm256_set1_ps(float(box.l));
+    const __m256 right = _mm256_set1_ps(float(box.r));
+    const __m256 bottom = _mm256_set1_ps(float(box.b));
+    const __m256 top = _mm256_set1_ps(float(box.t));
+    size_t hits = 0;
+    size_t i = 0;
+    for (; i + 8 <= count; i += 8) {
+        const __m256 px = _mm256_loadu_ps(x + i);
+        const __m256 py = _mm256_loadu_ps(y + i);
+        const __m256 inside = _mm256_and_ps(
+            _mm256_and_ps(_mm256_cmp_ps(px, left, _CMP_GE_OQ),
+                          _mm256_cmp_ps(px, right, _CMP_LE_OQ)),
+            _mm256_and_ps(_mm256_cmp_ps(py, bottom, _CMP_GE_OQ),
+                          _mm256_cmp_ps(py, top, _CMP_LE_OQ)));
+        hits +=
+            append_mask(uint32_t(_mm256_movemask_ps(inside)), i, out + hits);
+    }
+    const size_t tail = overlap_box_sse2(x + i, y + i, count - i, box,
+                                         out + hits);
+    for (size_t j = 0; j < tail; ++j) {
+        out[hits + j] += uint32_t(i);
+    }
+    return hits + tail;
+}
+#endif
+
+struct kernel_table_t
+{
+    cw::bullet::kernels::instruction_set_e instruction_set;
+    integrate_fn integrate;
+    overlap_box_fn overlap_box;
+};
+
+static kernel_table_t select_kernels() noexcept
+{
+    using cw::bullet::kernels::instruction_set_e;
+#ifdef CROSSWIRE_BULLET_KERNELS_X86
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2")) {
+        return {instruction_set_e::AVX2, integrate_avx2, overlap_box_avx2};
+    }
+    if (__builtin_cpu_supports("sse2")) {
+        return {instruction_set_e::SSE2, integrate_sse2, overlap_box_sse2};
+    }
+#endif
+    return {instruction_set_e::Scalar, integrate_scalar, overlap_box_scalar};
+}
+
+static const kernel_table_t &kernels() noexcept
+{
+    static const kernel_table_t table = select_kernels();
+    return table;
+}
+
+namespace cw::bullet::kernels {
+
+instruction_set_e instruction_set() noexcept
+{
+    return ::kernels().instruction_set;
+}
+
+void integrate(lib::slice_t<const float> x, lib::slice_t<const float> y,
+               lib::slice_t<const float> vx, lib::slice_t<const float> vy,
+               float timestep, lib::slice_t<float> out_x,
+               lib::slice_t<float> out_y) noexcept
+{
+    const size_t count = x.size();
+    if (y.size() != count || vx.size() != count || vy.size() != count ||
+        out_x.size() != count || out_y.size() != count) [[unlikely]] {
+        LN_FATAL("Mismatched array lengths passed to bullet::kernels::"
+                 "integrate");
+        std::abort();
+    }
+    ::kernels().integrate(x.data(), y.data(), vx.data(), vy.data(), timestep,
+                          out_x.data(), out_y.data(), count);
+}
+
+size_t overlap_box(lib::slice_t<const float> x, lib::slice_t<const float> y,
+                   const cpBB &box, lib::slice_t<uint32_t> out) noexcept
+{
+    const size_t count = x.size();
+    if (y.size() != count || out.size() < count) [[unlikely]] {
+        LN_FATAL("Mismatched array lengths passed to bullet::kernels::"
+                 "overlap_box");
+        std::abort();
+    }
+    return ::kernels().overlap_box(x.data(), y.data(), count, box, out.data());
+}
+
+} // namespace cw::bullet::kernels
@@ -0,0 +1,35 @@
+#pragma once
+/// Loops over packed particle arrays, with SSE2 and AVX2 versions chosen at
+/// runtime based on what the CPU supports. Other architectures (including
+/// wasm) always use the scalar versions.
+
+#include "chipmunk/cpBB.h"
+#include "thelib/slice.hpp"
+#include <cstdint>
+
+namespace cw::bullet::kernels {
+
+enum class instruction_set_e : uint8_t
+{
+    Scalar,
+    SSE2,
+    AVX2,
+};
+
+/// Which versions of the kernels are in use. Detected on first use.
+[[nodiscard]] instruction_set_e instruction_set() noexcept;
+
+/// out_x[i] = x[i] + vx[i] * timestep, and the same for y. All slices must be
+/// the same length. The outputs may be the same arrays as the inputs.
+void integrate(lib::slice_t<const float> x, lib::slice_t<const float> y,
+               lib::slice_t<const float> vx, lib::slice_t<const float> vy,
+               float timestep, lib::slice_t<float> out_x,
+               lib::slice_t<float> out_y) noexcept;
+
+/// Write the index of every point inside the box (edges included) to out, in
+/// ascending order, and return how many there were. out must be at least as
+/// long as x and y.
+size_t overlap_box(lib::slice_t<const float> x, lib::slice_t<const float> y,
+                   const cpBB &box, lib::slice_t<uint32_t> out) noexcept;
+
+} // namespace cw::bullet::kernels
@@ -0,0 +1,117 @@
+#include "bullet_renderer.hpp"
+#include "bullet.hpp"
+#include "bullet_kernels.hpp"
+#include "physics.hpp"
+#include "render_pipeline.hpp"
+#include "resources.hpp"
+#include <algorithm>
+#include <raylib.h>
+#include <rlgl.h>
+#include <vector>
+
+/// Number of bullets submitted to rlgl at a time. Each chunk checks the batch
+/// limit once instead of once per bullet.
+constexpr size_t bullets_per_chunk = 1024;
+
+/// How far outside of the visible area a bullet's position can be while still
+/// being drawn. Covers the size of the quad, plus the distance between a rigid
+/// body bullet's interpolated position and the current one which is culled.
+constexpr float cull_margin = 4 * cw::bullet_renderer::bullet_draw_size;
+
+/// Scratch space reused every frame: indices of the bullets that survived
+/// culling, and then the packed centers of every quad to draw
+static std::vector<uint32_t> visible;
+static std::vector<float> draw_x;
+static std::vector<float> draw_y;
+
+/// Fill the start of visible with the indices of every element of x and y
+/// which is inside of area, and return how many there are
+static size_t cull(lib::slice_t<const float> x, lib::slice_t<const float> y,
+                   const cpBB &area) noexcept
+{
+    if (x.size() == 0)
+        return 0;
+    if (visible.size() < x.size())
+        visible.resize(x.size());
+    return cw::bullet::kernels::overlap_box(x, y, area, visible);
+}
+
+static void gather_rigid_bullets(const cpBB &area, float alpha) noexcept
+{
+    const cw::physics::body_mirror_t bodies = cw::physics::dynamic_bodies();
+    const size_t count = cull(bodies.x, bodies.y, area);
+    const float *x = bodies.x.data();
+    const float *y = bodies.y.data();
+    const float *previous_x = bodies.previous_x.data();
+    const float *previous_y = bodies.previous_y.data();
+    const cw::game_id_e *id = bodies.id.data();
+    for (size_t j = 0; j < count; ++j) {
+        const uint32_t i = visible[j];
+        if (id[i] != cw::game_id_e::Bullet)
+            continue;
+        draw_x.push_back(previous_x[i] + ((x[i] - previous_x[i]) * alpha));
+        draw_y.push_back(previous_y[i] + ((y[i] - previous_y[i]) * alpha));
+    }
+}
+
+static void gather_particles(const cpBB &area) noexcept
+{
+    const cw::bullet::particle_view_t particles = cw::bullet::particles();
+    const size_t count = cull(particles.x, particles.y, area);
+    const float *x = particles.x.data();
+    const float *y = particles.y.data();
+    for (size_t j = 0; j < count; ++j) {
+        draw_x.push_back(x[visible[j]]);
+        draw_y.push_back(y[visible[j]]);
+    }
+}
+
+static void submit_quads(const Texture2D &texture) noexcept
+{
+    constexpr float half = cw::bullet_renderer::bullet_draw_size / 2;
+    rlSetTexture(texture.id);
+    for (size_t chunk = 0; chunk < draw_x.size(); chunk += bullets_per_chunk) {
+        const size_t end = std::min(chunk + bullets_per_chunk, draw_x.size());
+        rlCheckRenderBatchLimit(int(4 * (end - chunk)));
+        rlBegin(RL_QUADS);
+        rlColor4ub(255, 255, 255, 255);
+        rlNormal3f(0, 0, 1);
+        for (size_t i = chunk; i < end; ++i) {
+            const float x = draw_x[i];
+            const float y = draw_y[i];
+            // same winding as raylib's DrawTexturePro
+            rlTexCoord2f(0, 0);
+            rlVertex2f(x - half, y - half);
+            rlTexCoord2f(0, 1);
+            rlVertex2f(x - half, y + half);
+            rlTexCoord2f(1, 1);
+            rlVertex2f(x + half, y + half);
+            rlTexCoord2f(1, 0);
+            rlVertex2f(x + half, y - half);
+        }
+        rlEnd();
+    }
+    rlSetTexture(0);
+}
+
+namespace cw::bullet_renderer {
+
+void draw(float alpha) noexcept
+{
+    cpBB area = render_pipeline::visible_area();
+    area.l -= cull_margin;
+    area.b -= cull_margin;
+    area.r += cull_margin;
+    area.t += cull_margin;
+
+    draw_x.clear();
+    draw_y.clear();
+    gather_rigid_bullets(area, alpha);
+    gather_particles(area);
+    if (draw_x.empty())
+        return;
+
+    submit_quads(resources::get(resources::image_id_e::Projectile_Bullet));
+}
+
+} // namespace cw::bullet_renderer
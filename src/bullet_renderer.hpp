@@ -0,0 +1,16 @@
+#pragma once
+
+namespace cw::bullet_renderer {
+
+/// Width and height that every bullet and particle bullet is drawn at, the same
+/// size as their hitboxes
+inline constexpr float bullet_draw_size = 10;
+
+/// Draw every rigid body bullet and particle bullet which is on screen, as one
+/// textured quad each, all submitted to rlgl as a single batch with the same
+/// texture. Rigid body bullets are drawn alpha of the way between their
+/// position before the last physics step and their current position. Call
+/// inside of the camera's 2D mode.
+void draw(float alpha) noexcept;
+
+} // namespace cw::bullet_renderer
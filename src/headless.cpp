@@ -0,0 +1,89 @@
+/// Entry point for crosswire_headless: loads a level and runs the simulation
+/// for some number of ticks without opening a window, then prints how long it
+/// took. Usage: crosswire_headless [ticks] [level]
+#include "bullet.hpp"
+#include "constants/physics.hpp"
+#include "level_loader.hpp"
+#include "natural_log/natural_log.hpp"
+#include "physics.hpp"
+#include "terrain.hpp"
+#include "timer.hpp"
+#include "turret.hpp"
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <vector>
+
+using namespace cw;
+
+constexpr long default_ticks = 600;
+constexpr const char *default_level = "test";
+
+int main(int argc, char **argv)
+{
+    long ticks = default_ticks;
+    if (argc > 1) {
+        ticks = std::strtol(argv[1], nullptr, 10);
+        if (ticks <= 0) {
+            fmt::print("Invalid number of ticks \"{}\"\n", argv[1]);
+            return 1;
+        }
+    }
+    const char *level = argc > 2 ? argv[2] : default_level;
+
+    ln::init();
+    ln::set_minimum_level(ln::level_e::WARNING);
+    physics::init();
+    timer::init();
+    terrain::init();
+    bullet::init();
+    turret::init();
+    loader::init();
+
+    loader::load_level(level);
+
+    std::vector<double> tick_seconds;
+    tick_seconds.reserve(size_t(ticks));
+
+    using clock = std::chrono::steady_clock;
+    const auto start = clock::now();
+    for (long i = 0; i < ticks; ++i) {
+        const auto tick_start = clock::now();
+        timer::update();
+        turret::update(PHYSICS_TIME_STEP, {});
+        bullet::update(PHYSICS_TIME_STEP);
+        bullet::update_particles(PHYSICS_TIME_STEP, {});
+        physics::update(PHYSICS_TIME_STEP);
+        tick_seconds.push_back(
+            std::chrono::duration<double>(clock::now() - tick_start).count());
+    }
+    const double total =
+        std::chrono::duration<double>(clock::now() - start).count();
+
+    std::sort(tick_seconds.begin(), tick_seconds.end());
+    const auto percentile = [&tick_seconds](double fraction) {
+        const auto index = size_t(fraction * double(tick_seconds.size() - 1));
+        return tick_seconds[index] * 1000.0;
+    };
+
+    fmt::print("level \"{}\": {} ticks in {:.3f}s ({:.1f} ticks/s)\n", level,
+               ticks, total, double(ticks) / total);
+    fmt::print("tick ms: min {:.4f} median {:.4f} p99 {:.4f} max {:.4f}\n",
+               percentile(0), percentile(0.5), percentile(0.99),
+               percentile(1));
+#ifdef CROSSWIRE_PHYSICS_STATS
+    const auto &stats = physics::stats();
+    fmt::print("last tick: {} active bodies, {} sleeping, {} arbiters, {} "
+               "contacts\n",
+               stats.active_bodies, stats.sleeping_bodies, stats.arbiters,
+               stats.contacts);
+#endif
+
+    loader::cleanup();
+    turret::cleanup();
+    bullet::cleanup();
+    terrain::cleanup();
+    timer::cleanup();
+    physics::cleanup();
+    return 0;
+}
@@ -1,5 +1,13 @@
 #pragma once
 
 #define PHYSICS_TIME_STEP (1.0f / 60.0f)
+// most physics steps to run in one frame when catching up after a slow frame.
+// any more time than this is dropped, slowing the game down instead of making
+// every following frame slower too
+#define PHYSICS_MAX_STEPS_PER_FRAME 5
 #define GRAVITY 9.81f
 #define PHYSICS_ITERATIONS 10
+// how long a body must be idle before it falls asleep, in seconds
+#define PHYSICS_SLEEP_TIME_THRESHOLD 0.5f
+// bodies further than this from the camera target are put to sleep
+#define PHYSICS_ACTIVATION_RADIUS 400.0f
@@ -3,11 +3,39 @@
 #include "crosswire_editor/serialize.h"
 #include "natural_log/natural_log.hpp"
 #include "terrain.hpp"
+#include "world.hpp"
+#include <algorithm>
 #include <vector>
 
-static std::vector<cw::build_site_t> sites;
-
 namespace cw::loader {
+struct world_state_t
+{
+    std::vector<build_site_t> sites;
+    lib::opt_t<cpBB> bounds;
+};
+
+static void expand(cpBB &bounds, lib::vect_t point) noexcept
+{
+    bounds.l = std::min(bounds.l, cpFloat(point.x));
+    bounds.b = std::min(bounds.b, cpFloat(point.y));
+    bounds.r = std::max(bounds.r, cpFloat(point.x));
+    bounds.t = std::max(bounds.t, cpFloat(point.y));
+}
+
+static world_state_t &state() noexcept
+{
+    return expect_world_state(current_world().loader, "loader");
+}
+
+void init() noexcept
+{
+    current_world().loader = create_world_state<world_state_t>();
+}
+
+void cleanup() noexcept { destroy_world_state(current_world().loader); }
+
+lib::opt_t<cpBB> level_bounds() noexcept { return state().bounds; }
+
 void load_level(const char *levelname) noexcept
 {
     Level level;
@@ -21,9 +49,17 @@ void load_level(const char *levelname) noexcept
         return;
     }
 
+    // build sites from the previous level are replaced along with its terrain
+    auto &sites = state().sites;
+    sites.clear();
+    cpBB bounds{INFINITY, INFINITY, -INFINITY, -INFINITY};
     for (const auto &site : level.build_sites) {
-        sites.emplace_back(lib::vect_t{site.position_a.x, site.position_a.y});
-        sites.emplace_back(lib::vect_t{site.position_b.x, site.position_b.y});
+        const lib::vect_t a{site.position_a.x, site.position_a.y};
+        const lib::vect_t b{site.position_b.x, site.position_b.y};
+        sites.emplace_back(a);
+        sites.emplace_back(b);
+        expand(bounds, a);
+        expand(bounds, b);
     }
 
     // clear existing terrain
@@ -50,6 +86,18 @@ void load_level(const char *levelname) noexcept
         lib::slice_t<const lib::vect_t> realslice = lib::raw_slice(
             const_cast<const lib::vect_t &>(*libslice.data()), libslice.size());
         terrain::load_polygon(id, realslice);
+        for (const lib::vect_t &vertex : realslice) {
+            expand(bounds, vertex);
+        }
+    }
+
+    if (bounds.l <= bounds.r && bounds.b <= bounds.t) {
+        state().bounds = bounds;
+    } else {
+        LN_WARN_FMT("Level {} has no terrain or build sites, so it has no "
+                    "bounds",
+                    levelname);
+        state().bounds.reset();
     }
 }
 } // namespace cw::loader
@@ -1,5 +1,13 @@
 #pragma once
+#include "chipmunk/cpBB.h"
+#include "thelib/opt.hpp"
 
 namespace cw::loader {
+void init() noexcept;
+void cleanup() noexcept;
 void load_level(const char* levelname) noexcept;
+
+/// Box around all of the terrain and build sites of the last level that was
+/// loaded successfully, or nothing if there hasn't been one
+[[nodiscard]] lib::opt_t<cpBB> level_bounds() noexcept;
 }
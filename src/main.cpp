@@ -3,6 +3,8 @@
 #endif
 #include "build_site.hpp"
 #include "bullet.hpp"
+#include "bullet_renderer.hpp"
+#include "constants/physics.hpp"
 #include "constants/screen.hpp"
 #include "globals.hpp"
 #include "input.hpp"
@@ -12,8 +14,10 @@
 #include "render_pipeline.hpp"
 #include "resources.hpp"
 #include "terrain.hpp"
+#include "timer.hpp"
 #include "level_loader.hpp"
 #include "thelib/opt.hpp"
+#include <cmath>
 #include <raylib.h>
 
 using namespace cw;
@@ -29,6 +33,11 @@ static lib::opt_t<build_site_t> build_site_2;
 static lib::opt_t<build_site_t> build_site_3;
 static lib::opt_t<build_site_t> build_site_4;
 
+/// Time which has passed but not been simulated yet
+static float physics_accumulator = 0;
+/// How far the renderer is between the last two physics steps, from 0 to 1
+static float interpolation_alpha = 1;
+
 #ifdef __EMSCRIPTEN__
 extern "C" int emsc_main(void)
 #else
@@ -40,9 +49,11 @@ int main()
     window_setup();
     render_pipeline::init();
     physics::init();
+    timer::init();
     terrain::init();
     resources::load();
     bullet::init();
+    loader::init();
 
     loader::load_level("test");
 
@@ -75,9 +86,11 @@ int main()
 
     // destroy player before cleaning up physics. not necessary but cool!!!!!
     my_player.reset();
+    loader::cleanup();
+    bullet::cleanup();
     terrain::cleanup();
+    timer::cleanup();
     physics::cleanup();
-    bullet::cleanup();
     resources::cleanup();
     return 0;
 }
@@ -89,7 +102,27 @@ static void update()
     update_virtual_cursor_position(get_screen_scale());
     my_player.value().update();
 
-    physics::update(1.0f / 60.0f);
+    physics::update_activation(get_main_camera().target,
+                               PHYSICS_ACTIVATION_RADIUS);
+
+    // run however many fixed steps fit into the time since the last frame
+    physics_accumulator += GetFrameTime();
+    int steps = 0;
+    while (physics_accumulator >= PHYSICS_TIME_STEP &&
+           steps < PHYSICS_MAX_STEPS_PER_FRAME) {
+        timer::update();
+        bullet::update(PHYSICS_TIME_STEP);
+        bullet::update_particles(PHYSICS_TIME_STEP,
+                                 my_player.value().hitbox());
+        physics::update(PHYSICS_TIME_STEP);
+        physics_accumulator -= PHYSICS_TIME_STEP;
+        ++steps;
+    }
+    if (physics_accumulator >= PHYSICS_TIME_STEP) {
+        physics_accumulator = std::fmod(physics_accumulator, PHYSICS_TIME_STEP);
+    }
+    interpolation_alpha = physics_accumulator / PHYSICS_TIME_STEP;
+    my_player.value().update_camera(GetFrameTime(), interpolation_alpha);
 
     render_pipeline::render(draw, draw_hud);
 }
@@ -97,13 +130,24 @@ static void update()
 static void draw()
 {
     my_player.value().draw();
-    physics::debug_draw_all_shapes();
+    bullet_renderer::draw(interpolation_alpha);
+    physics::debug_draw_all_shapes(interpolation_alpha);
+}
+static void draw_hud()
+{
+    DrawFPS(30, 10);
+#ifdef CROSSWIRE_PHYSICS_STATS
+    const auto &stats = physics::stats();
+    DrawText(TextFormat("physics: %.2fms, %zu active, %zu sleeping, %zu "
+                        "arbiters, %zu contacts",
+                        stats.step_seconds * 1000.0, stats.active_bodies,
+                        stats.sleeping_bodies, stats.arbiters, stats.contacts),
+             30, 30, 10, DARKGRAY);
+#endif
 }
-static void draw_hud() { DrawFPS(30, 10); }
 
 static void window_setup()
 {
-    SetTargetFPS(60);
     SetConfigFlags(FLAG_WINDOW_RESIZABLE | FLAG_VSYNC_HINT);
     InitWindow(WINDOW_WIDTH, WINDOW_HEIGHT, "Crosswire");
     SetWindowMinSize(WINDOW_WIDTH, WINDOW_HEIGHT);
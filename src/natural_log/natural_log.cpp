@@ -24,12 +24,20 @@ static_assert(std::underlying_type_t<ln::level_e>(ln::level_e::NONE) == static_c
 
 namespace ln {
 
-// tell raylib to use our internal colored logger
-void init() TESTING_NOEXCEPT { SetTraceLogCallback(internal); }
+// tell raylib to use our internal colored logger. headless builds don't link
+// raylib, so there is nothing to tell
+void init() TESTING_NOEXCEPT
+{
+#ifndef CROSSWIRE_HEADLESS
+    SetTraceLogCallback(internal);
+#endif
+}
 
 void set_minimum_level(level_e level) TESTING_NOEXCEPT
 {
+#ifndef CROSSWIRE_HEADLESS
     SetTraceLogLevel(std::underlying_type_t<level_e>(level));
+#endif
     minLevel = level;
 }
 
@@ -1,13 +1,25 @@
 #include "physics.hpp"
+#include "constants/physics.hpp"
 #include "game_ids.hpp"
+#include "physics_memory.hpp"
 #include "thelib/body.hpp"
 #include "thelib/opt.hpp"
 #include "thelib/shape.hpp"
 #include "thelib/space.hpp"
+#include "world.hpp"
+#include <algorithm>
+#include <array>
 #include <raylib.h>
+#include <rlgl.h>
+#include <vector>
+#ifdef CROSSWIRE_PHYSICS_STATS
+#include <chrono>
+#endif
 
 /// Number of physics bodies that we reserve space for at the start
 constexpr size_t initial_reservation = 512;
+/// Number of collision events that we reserve space for at the start
+constexpr size_t initial_event_reservation = 256;
 
 struct physics_user_data_t
 {
@@ -35,26 +47,538 @@ static_assert(alignof(user_data_allocator::handle_t) ==
               alignof(unsafe_user_data_handle_t));
 static_assert(alignof(unsafe_user_data_handle_t) < alignof(cpDataPointer));
 
-static lib::opt_t<cw::physics::poly_shape_allocator> poly_shapes;
-static lib::opt_t<cw::physics::segment_shape_allocator> segment_shapes;
-static lib::opt_t<cw::physics::body_allocator> bodies;
-static lib::opt_t<lib::space_t> space;
-static lib::opt_t<user_data_allocator> user_data;
+
+/// Creations and deletions which were requested while the space was locked.
+/// They are applied in bulk by flush_deferred(): first all additions to the
+/// space, then all removals from the space, then all pool frees.
+struct deferred_commands_t
+{
+    std::vector<cw::physics::raw_body_t> bodies_to_add;
+    std::vector<cw::physics::raw_poly_shape_t> poly_shapes_to_add;
+    std::vector<cw::physics::raw_segment_shape_t> segment_shapes_to_add;
+    std::vector<cw::physics::raw_body_t> bodies_to_delete;
+    std::vector<cw::physics::raw_poly_shape_t> poly_shapes_to_delete;
+    std::vector<cw::physics::raw_segment_shape_t> segment_shapes_to_delete;
+
+    [[nodiscard]] bool empty() const noexcept
+    {
+        return bodies_to_add.empty() && poly_shapes_to_add.empty() &&
+               segment_shapes_to_add.empty() && bodies_to_delete.empty() &&
+               poly_shapes_to_delete.empty() &&
+               segment_shapes_to_delete.empty();
+    }
+
+    void clear() noexcept
+    {
+        bodies_to_add.clear();
+        poly_shapes_to_add.clear();
+        segment_shapes_to_add.clear();
+        bodies_to_delete.clear();
+        poly_shapes_to_delete.clear();
+        segment_shapes_to_delete.clear();
+    }
+};
+/// The area set by update_activation(), plus scratch space for the bodies that
+/// need to change state, since they can't be changed while iterating the space
+struct activation_state_t
+{
+    lib::vect_t center = lib::vect_t::zero();
+    float radius = INFINITY;
+    std::vector<lib::body_t *> to_sleep;
+    std::vector<lib::body_t *> to_wake;
+};
+
+/// Position of a body before the most recent step, indexed by the index of
+/// the body's handle. Used for interpolating between steps when rendering.
+struct previous_position_t
+{
+    lib::vect_t position;
+    cw::physics::gen_t generation;
+};
+
+/// Backing storage for physics::dynamic_bodies()
+struct body_mirror_storage_t
+{
+    std::vector<float> x;
+    std::vector<float> y;
+    std::vector<float> previous_x;
+    std::vector<float> previous_y;
+    std::vector<float> vx;
+    std::vector<float> vy;
+    std::vector<cw::game_id_e> id;
+    std::vector<cw::physics::raw_body_t> handle;
+};
+
+/// A line segment drawn by debug_draw_all_shapes(), in world space
+struct debug_line_t
+{
+    lib::vect_t a;
+    lib::vect_t b;
+    Color color;
+};
+
+/// Lines emitted by debug_draw_all_shapes(). Shapes attached to static bodies
+/// don't move, so their lines are only rebuilt when one is created or deleted.
+struct debug_draw_cache_t
+{
+    std::vector<debug_line_t> static_lines;
+    std::vector<debug_line_t> dynamic_lines;
+    bool static_dirty = true;
+    /// Colors for shapes whose game id doesn't have one in
+    /// debug_colors_by_id, filled out once since ColorFromHSV is not constexpr
+    std::array<Color, 36> fallback_colors;
+};
+
+#ifdef CROSSWIRE_PHYSICS_STATS
+/// The callbacks of a handler added with add_collision_handler(). Chipmunk
+/// calls counting wrappers instead, which then call these.
+struct counted_handler_t
+{
+    cpCollisionBeginFunc begin;
+    cpCollisionPreSolveFunc pre_solve;
+    cpCollisionPostSolveFunc post_solve;
+    cpCollisionSeparateFunc separate;
+    cpDataPointer user_data;
+};
+#endif
+
+namespace cw::physics {
+/// Everything the physics module keeps for one world
+struct world_state_t
+{
+    lib::opt_t<poly_shape_allocator> poly_shapes;
+    lib::opt_t<segment_shape_allocator> segment_shapes;
+    lib::opt_t<body_allocator> bodies;
+    lib::opt_t<lib::space_t> space;
+    lib::opt_t<user_data_allocator> user_data;
+    lib::opt_t<std::vector<collision_event_t>> events;
+    lib::opt_t<deferred_commands_t> deferred;
+    /// The commands being applied by flush_deferred(). Swapped with deferred so
+    /// that callbacks which run while applying them can queue more.
+    lib::opt_t<deferred_commands_t> flushing;
+    lib::opt_t<activation_state_t> activation;
+    lib::opt_t<std::vector<previous_position_t>> previous_positions;
+    lib::opt_t<body_mirror_storage_t> body_mirror;
+    lib::opt_t<debug_draw_cache_t> debug_draw_cache;
+    /// Indexed by the index of a body's handle. Holds the generation of the
+    /// handle if that body is disabled, so deleting it clears the flag.
+    lib::opt_t<std::vector<gen_t>> disabled_generations;
+    /// Filled in by update() when CROSSWIRE_PHYSICS_STATS is defined
+    stats_t last_stats{};
+#ifdef CROSSWIRE_PHYSICS_STATS
+    /// Indexed by the two collision types of the handler. Never moves, since
+    /// chipmunk keeps pointers to these as the handlers' user data.
+    std::array<std::array<counted_handler_t, size_t(collision_type_e::MAX)>,
+               size_t(collision_type_e::MAX)>
+        counted_handlers{};
+#endif
+    /// Number of begin_batch() calls without a matching end
+    size_t batch_depth = 0;
+};
+} // namespace cw::physics
+
+static cw::physics::world_state_t &state() noexcept
+{
+    return cw::expect_world_state(cw::current_world().physics, "physics");
+}
+
+/// Whether a body was taken out of the simulation with physics::disable()
+static bool is_disabled_body(const cw::physics::raw_body_t &handle) noexcept
+{
+    const auto &disabled = state().disabled_generations.value();
+    return handle.index() < disabled.size() &&
+           disabled[handle.index()] == handle.generation();
+}
+static bool is_disabled_body(const lib::body_t &body) noexcept
+{
+    auto handle = state().bodies.value().get_handle_from_item(&body);
+    return handle.okay() && is_disabled_body(handle.release());
+}
+
+static cpBool record_begin(cpArbiter *arb, cpSpace *space,
+                           cpDataPointer) noexcept;
+static void record_post_solve(cpArbiter *arb, cpSpace *space,
+                              cpDataPointer) noexcept;
+static void record_separate(cpArbiter *arb, cpSpace *space,
+                            cpDataPointer) noexcept;
+#ifdef CROSSWIRE_PHYSICS_STATS
+static cpBool counted_begin(cpArbiter *arb, cpSpace *space,
+                            cpDataPointer data) noexcept;
+static cpBool counted_pre_solve(cpArbiter *arb, cpSpace *space,
+                                cpDataPointer data) noexcept;
+static void counted_post_solve(cpArbiter *arb, cpSpace *space,
+                               cpDataPointer data) noexcept;
+static void counted_separate(cpArbiter *arb, cpSpace *space,
+                             cpDataPointer data) noexcept;
+#endif
+
+/// Remove a body or shape from the space, if it is in one. It may not be if its
+/// creation was deferred and then it got deleted before the flush.
+static void remove_from_space(lib::body_t &body) noexcept
+{
+    body.remove_from_space();
+}
+static void remove_from_space(lib::poly_shape_t &shape) noexcept
+{
+    shape.parent_cast()->remove_from_space();
+}
+static void remove_from_space(lib::segment_shape_t &shape) noexcept
+{
+    shape.parent_cast()->remove_from_space();
+}
+
+template <typename allocator_t>
+static void free_from_pool(allocator_t &allocator,
+                           const typename allocator_t::handle_t &handle) noexcept
+{
+    auto status = allocator.free(handle);
+    if (!status.okay()) [[unlikely]] {
+        LN_WARN_FMT("Failed to free physics {} with errcode {}",
+                    typeid(typename allocator_t::type).name(),
+                    fmt::underlying(status.status()));
+    }
+}
+
+template <typename handle_t>
+static void sort_and_dedupe(std::vector<handle_t> &handles) noexcept
+{
+    std::sort(handles.begin(), handles.end(),
+              [](const handle_t &a, const handle_t &b) {
+                  return a.index() < b.index() ||
+                         (a.index() == b.index() &&
+                          a.generation() < b.generation());
+              });
+    handles.erase(std::unique(handles.begin(), handles.end()), handles.end());
+}
+
+template <typename allocator_t>
+static void
+add_all_to_space(allocator_t &allocator,
+                 const std::vector<typename allocator_t::handle_t> &handles)
+{
+    for (const auto &handle : handles) {
+        auto res = allocator.get(handle);
+        // it was deleted before it ever made it into the space
+        if (!res.okay())
+            continue;
+        auto &item = res.release();
+        if constexpr (std::is_same_v<typename allocator_t::type, lib::body_t>) {
+            state().space.value().add(item);
+        } else {
+            state().space.value().add(*item.parent_cast());
+        }
+    }
+}
+
+/// Remove everything in handles from the space, and drop the handles which
+/// were already freed so that they aren't freed again. A deletion queued by a
+/// separate callback while the same object was being removed is expected to
+/// have been freed already, so only warn about that when warn_if_freed is set.
+template <typename allocator_t>
+static void
+remove_all_from_space(allocator_t &allocator,
+                      std::vector<typename allocator_t::handle_t> &handles,
+                      bool warn_if_freed)
+{
+    size_t kept = 0;
+    for (const auto &handle : handles) {
+        auto res = allocator.get(handle);
+        if (!res.okay()) [[unlikely]] {
+            if (warn_if_freed) {
+                LN_WARN("Deferred deletion of physics object which was "
+                        "already freed");
+            }
+            continue;
+        }
+        remove_from_space(res.release());
+        handles[kept++] = handle;
+    }
+    handles.erase(handles.begin() + ptrdiff_t(kept), handles.end());
+}
+
+#ifdef CROSSWIRE_PHYSICS_STATS
+template <typename allocator_t>
+static cw::physics::pool_stats_t pool_stats(allocator_t &allocator) noexcept
+{
+    return {.size = allocator.size(), .capacity = allocator.capacity()};
+}
+
+/// Count everything in the space after a step. Reads chipmunk's internal
+/// arrays directly since there is no public API for most of this.
+static void gather_space_stats(cw::physics::stats_t &stats) noexcept
+{
+    lib::space_t &s = state().space.value();
+    stats.active_bodies = size_t(s.dynamicBodies->num);
+    stats.static_bodies = size_t(s.staticBodies->num);
+
+    // each sleeping component is a linked list of bodies starting at its root
+    stats.sleeping_bodies = 0;
+    for (int i = 0; i < s.sleepingComponents->num; ++i) {
+        auto *body = static_cast<cpBody *>(s.sleepingComponents->arr[i]);
+        for (; body != nullptr; body = body->sleeping.next) {
+            ++stats.sleeping_bodies;
+        }
+    }
+
+    stats.arbiters = size_t(s.arbiters->num);
+    stats.contacts = 0;
+    for (int i = 0; i < s.arbiters->num; ++i) {
+        stats.contacts += size_t(
+            cpArbiterGetCount(static_cast<cpArbiter *>(s.arbiters->arr[i])));
+    }
+
+    stats.body_pool = pool_stats(state().bodies.value());
+    stats.poly_shape_pool = pool_stats(state().poly_shapes.value());
+    stats.segment_shape_pool = pool_stats(state().segment_shapes.value());
+    stats.user_data_pool = pool_stats(state().user_data.value());
+    stats.internal_memory = cw::physics::memory::stats();
+    stats.poly_shapes = stats.poly_shape_pool.size;
+    stats.segment_shapes = stats.segment_shape_pool.size;
+}
+#endif
+
+/// Save the position of every dynamic body before it gets stepped
+static void record_previous_positions() noexcept
+{
+    auto &previous = state().previous_positions.value();
+    previous.resize(state().bodies.value().capacity(),
+                    previous_position_t{
+                        .position = lib::vect_t::zero(),
+                        .generation = cw::physics::invalid_generation,
+                    });
+    for (lib::body_t &body : state().bodies.value()) {
+        if (body.space == nullptr || body.type() != lib::body_t::Type::DYNAMIC)
+            continue;
+        auto handle = state().bodies.value().get_handle_from_item(&body);
+        if (!handle.okay()) [[unlikely]]
+            continue;
+        auto raw = handle.release();
+        previous[raw.index()] = previous_position_t{
+            .position = body.position(),
+            .generation = raw.generation(),
+        };
+    }
+}
+
+/// Where the body was before the last step, or where it is now if it didn't
+/// exist before the last step
+static lib::vect_t previous_position_of(const cw::physics::raw_body_t &handle,
+                                        const lib::body_t &body) noexcept
+{
+    const auto &previous = state().previous_positions.value();
+    if (handle.index() < previous.size() &&
+        previous[handle.index()].generation == handle.generation()) {
+        return previous[handle.index()].position;
+    }
+    return body.position();
+}
+
+/// Number of lines submitted to rlgl at a time. Each chunk checks the batch
+/// limit once instead of once per line.
+constexpr size_t debug_lines_per_chunk = 256;
+
+/// Debug colors indexed by game id. Entries with zero alpha have no specific
+/// color and use one of the fallback colors instead.
+static constexpr auto debug_colors_by_id = []() {
+    std::array<Color, 256> colors{};
+    colors[size_t(cw::game_id_e::Player)] = ::GREEN;
+    colors[size_t(cw::game_id_e::Bullet)] = ::RED;
+    colors[size_t(cw::game_id_e::Terrain_Ditch)] = ::BROWN;
+    colors[size_t(cw::game_id_e::Terrain_Obstacle)] = ::BLACK;
+    return colors;
+}();
+
+static bool is_static(const lib::shape_t &shape) noexcept
+{
+    return cpBodyGetType(cpShapeGetBody(&shape)) == CP_BODY_TYPE_STATIC;
+}
+
+static const lib::body_t *shape_body(const lib::shape_t &shape) noexcept
+{
+    return lib::body_t::from_chipmunk(cpShapeGetBody(&shape));
+}
+
+/// Called whenever a shape is created or deleted, so that the cached lines for
+/// static geometry get rebuilt if needed.
+static void mark_debug_geometry_changed(const lib::shape_t &shape) noexcept
+{
+    if (state().debug_draw_cache.has_value() && is_static(shape))
+        state().debug_draw_cache.value().static_dirty = true;
+}
+
+template <typename T>
+static Color debug_color_for(T &shape, size_t fallback_index) noexcept
+{
+    auto id_res = cw::get_physics_id(*shape.parent_cast());
+    if (id_res.okay()) {
+        const Color color = debug_colors_by_id[size_t(id_res.release())];
+        if (color.a != 0)
+            return color;
+    }
+    const auto &fallbacks = state().debug_draw_cache.value().fallback_colors;
+    return fallbacks[fallback_index % fallbacks.size()];
+}
+
+/// Where to draw a body: in between its previous and current position for
+/// dynamic bodies, and just its position otherwise
+static lib::vect_t debug_draw_position(lib::body_t &body, float alpha) noexcept
+{
+    if (body.type() != lib::body_t::Type::DYNAMIC)
+        return body.position();
+    auto handle = state().bodies.value().get_handle_from_item(&body);
+    if (!handle.okay())
+        return body.position();
+    const lib::vect_t previous = previous_position_of(handle.release(), body);
+    return previous + ((body.position() - previous) * alpha);
+}
+
+static void emit_debug_lines(std::vector<debug_line_t> &out,
+                             lib::segment_shape_t &shape, float alpha) noexcept
+{
+    const lib::vect_t position =
+        debug_draw_position(*shape.parent_cast()->body(), alpha);
+    out.push_back(debug_line_t{
+        .a = position + shape.a(),
+        .b = position + shape.b(),
+        .color = debug_color_for(shape, out.size()),
+    });
+}
+
+static void emit_debug_lines(std::vector<debug_line_t> &out,
+                             lib::poly_shape_t &shape, float alpha) noexcept
+{
+    assert(shape.count() > 1);
+    const lib::vect_t position =
+        debug_draw_position(*shape.parent_cast()->body(), alpha);
+    const Color color = debug_color_for(shape, out.size());
+    for (int i = 0; i < shape.count(); ++i) {
+        out.push_back(debug_line_t{
+            .a = position + shape.vertex(i),
+            .b = position + shape.vertex((i + 1) % shape.count()),
+            .color = color,
+        });
+    }
+}
+
+static void submit_debug_lines(const std::vector<debug_line_t> &lines) noexcept
+{
+#ifdef CROSSWIRE_HEADLESS
+    (void)lines;
+#else
+    for (size_t chunk = 0; chunk < lines.size();
+         chunk += debug_lines_per_chunk) {
+        const size_t end = std::min(chunk + debug_lines_per_chunk, lines.size());
+        rlCheckRenderBatchLimit(int(2 * (end - chunk)));
+        rlBegin(RL_LINES);
+        for (size_t i = chunk; i < end; ++i) {
+            const debug_line_t &line = lines[i];
+            rlColor4ub(line.color.r, line.color.g, line.color.b, line.color.a);
+            rlVertex2f(line.a.x, line.a.y);
+            rlVertex2f(line.b.x, line.b.y);
+        }
+        rlEnd();
+    }
+#endif
+}
+
+/// Copy the position, velocity, and id of every dynamic body into body_mirror.
+/// Walks the pool rather than the space so the bodies are visited in memory
+/// order.
+static void refresh_body_mirror() noexcept
+{
+    auto &mirror = state().body_mirror.value();
+    mirror.x.clear();
+    mirror.y.clear();
+    mirror.previous_x.clear();
+    mirror.previous_y.clear();
+    mirror.vx.clear();
+    mirror.vy.clear();
+    mirror.id.clear();
+    mirror.handle.clear();
+
+    for (lib::body_t &body : state().bodies.value()) {
+        if (body.space == nullptr || body.type() != lib::body_t::Type::DYNAMIC)
+            continue;
+        auto handle = state().bodies.value().get_handle_from_item(&body);
+        if (!handle.okay()) [[unlikely]]
+            continue;
+        const auto raw = handle.release();
+        if (is_disabled_body(raw))
+            continue;
+        const lib::vect_t position = body.position();
+        const lib::vect_t previous = previous_position_of(raw, body);
+        const lib::vect_t velocity = body.velocity();
+        auto id = cw::physics::get_id(body);
+        mirror.x.push_back(position.x);
+        mirror.y.push_back(position.y);
+        mirror.previous_x.push_back(previous.x);
+        mirror.previous_y.push_back(previous.y);
+        mirror.vx.push_back(velocity.x);
+        mirror.vy.push_back(velocity.y);
+        mirror.id.push_back(id.has_value() ? id.value() : cw::game_id_e::NULLP);
+        mirror.handle.push_back(raw);
+    }
+}
 
 namespace cw::physics {
 /// Initialize physics related resources
 void init() noexcept
 {
-    space.emplace();
-    space.value().set_collision_slop(0);
-    space.value().set_iterations(3);
+    // chipmunk starts allocating as soon as the space exists
+    memory::init();
+    current_world().physics = create_world_state<world_state_t>();
+    state().space.emplace();
+    state().space.value().set_collision_slop(0);
+    state().space.value().set_iterations(3);
 
     // fix 50% of collision overlap per frame at 60hz
-    space.value().set_collision_bias(powf(1.0 - 0.5, 60.0));
-    poly_shapes.emplace(initial_reservation);
-    segment_shapes.emplace(initial_reservation);
-    bodies.emplace(initial_reservation);
-    user_data.emplace(initial_reservation);
+    state().space.value().set_collision_bias(powf(1.0 - 0.5, 60.0));
+    // sleeping has to be enabled for update_activation() to work
+    state().space.value().set_sleep_time_threshold(
+        PHYSICS_SLEEP_TIME_THRESHOLD);
+    state().poly_shapes.emplace(initial_reservation);
+    state().segment_shapes.emplace(initial_reservation);
+    state().bodies.emplace(initial_reservation);
+    state().user_data.emplace(initial_reservation);
+    state().events.emplace();
+    state().events.value().reserve(initial_event_reservation);
+    state().deferred.emplace();
+    state().flushing.emplace();
+    state().debug_draw_cache.emplace();
+    state().activation.emplace();
+    state().body_mirror.emplace();
+    {
+        // dynamic_bodies() makes slices of these before the first step, and
+        // those can't point at null
+        auto &mirror = state().body_mirror.value();
+        mirror.x.reserve(initial_reservation);
+        mirror.y.reserve(initial_reservation);
+        mirror.previous_x.reserve(initial_reservation);
+        mirror.previous_y.reserve(initial_reservation);
+        mirror.vx.reserve(initial_reservation);
+        mirror.vy.reserve(initial_reservation);
+        mirror.id.reserve(initial_reservation);
+        mirror.handle.reserve(initial_reservation);
+    }
+    state().previous_positions.emplace();
+    state().disabled_generations.emplace();
+#ifndef CROSSWIRE_HEADLESS
+    {
+        auto &fallbacks = state().debug_draw_cache.value().fallback_colors;
+        for (size_t i = 0; i < fallbacks.size(); ++i) {
+            fallbacks[i] =
+                ColorFromHSV(float(i) * (360.0f / fallbacks.size()), 1, 1);
+        }
+    }
+#endif
+
+    // the default handler is what calls the wildcard handlers, so the
+    // recording functions below have to call them as well
+    cpCollisionHandler *default_handler =
+        cpSpaceAddDefaultCollisionHandler(&state().space.value());
+    default_handler->beginFunc = record_begin;
+    default_handler->postSolveFunc = record_post_solve;
+    default_handler->separateFunc = record_separate;
 }
 
 /// Delete all physics data
@@ -63,36 +587,72 @@ void cleanup() noexcept
     // TODO: figure out why iterating over bodies and poly_shapes causes bad
     // iterator access error?
 
-    // for (lib::body_t &body : bodies.value()) {
-    //     space.value().remove(body);
+    // for (lib::body_t &body : state().bodies.value()) {
+    //     state().space.value().remove(body);
     // }
-    // for (lib::poly_shape_t &shape : poly_shapes.value()) {
-    //     space.value().remove(*shape.parent_cast());
+    // for (lib::poly_shape_t &shape : state().poly_shapes.value()) {
+    //     state().space.value().remove(*shape.parent_cast());
     // }
-    // for (lib::segment_shape_t &shape : segment_shapes.value()) {
-    //     space.value().remove(*shape.parent_cast());
+    // for (lib::segment_shape_t &shape : state().segment_shapes.value()) {
+    //     state().space.value().remove(*shape.parent_cast());
     // }
 
-    poly_shapes.reset();
-    segment_shapes.reset();
-    bodies.reset();
-    user_data.reset();
-    space.reset();
+    state().poly_shapes.reset();
+    state().segment_shapes.reset();
+    state().bodies.reset();
+    state().user_data.reset();
+    state().space.reset();
+    state().events.reset();
+    state().deferred.reset();
+    state().flushing.reset();
+    state().debug_draw_cache.reset();
+    state().activation.reset();
+    state().body_mirror.reset();
+    state().previous_positions.reset();
+    state().disabled_generations.reset();
+    destroy_world_state(current_world().physics);
+    // the space is gone, so anything chipmunk still has allocated is garbage
+    memory::cleanup();
+}
+
+/// If an object's user data points into the user data pool, free it and store
+/// only the id in the object again
+template <typename T> static void release_user_data(T &object) noexcept
+{
+    auto res = get_physics_id(object);
+    if (res.okay() ||
+        res.status() != physics_object_get_id_result_e::ItsAPointer)
+        return;
+
+    auto handle = *reinterpret_cast<const user_data_allocator::handle_t *>(
+        &object.userData);
+    auto &pool = state().user_data.value();
+    auto maybe_user_data = pool.get(handle);
+    if (!maybe_user_data.okay()) [[unlikely]] {
+        LN_WARN("Physics object points at user data which was already freed");
+        return;
+    }
+    const game_id_e id = maybe_user_data.release().id;
+    free_from_pool(pool, handle);
+    set_physics_id(object, id);
 }
 
 template <typename T>
 void generic_set_user_data_and_id(T &object, game_id_e id, void *data) noexcept
 {
-    if (!user_data.has_value()) [[unlikely]] {
+    if (!state().user_data.has_value()) [[unlikely]] {
         LN_FATAL("attempt to set user data of physics body before physics "
                  "module was initialized");
         std::abort();
     }
 
-    auto new_user_data = user_data.value().alloc_new(physics_user_data_t{
-        .id = id,
-        .user_data = data,
-    });
+    release_user_data(object);
+
+    auto new_user_data =
+        state().user_data.value().alloc_new(physics_user_data_t{
+            .id = id,
+            .user_data = data,
+        });
 
     if (!new_user_data.okay()) [[unlikely]] {
         LN_FATAL("Failed to allocate user data for physics object");
@@ -128,6 +688,11 @@ void set_user_data_and_id(raw_segment_shape_t handle, game_id_e id,
                                  data);
 }
 
+void clear_user_data(raw_body_t handle) noexcept
+{
+    release_user_data(get_body(handle));
+}
+
 template <typename T>
 requires(
     std::is_same_v<T, lib::shape_t> ||
@@ -145,7 +710,7 @@ requires(
     auto user_data_handle =
         *reinterpret_cast<const user_data_allocator::handle_t *>(
             &object.userData);
-    auto maybe_user_data = user_data.value().get(user_data_handle);
+    auto maybe_user_data = state().user_data.value().get(user_data_handle);
     if (maybe_user_data.okay()) {
         return maybe_user_data.release().user_data;
     } else {
@@ -195,7 +760,7 @@ auto generic_get_id = [](auto object) -> lib::opt_t<game_id_e> {
     auto user_data_handle =
         *reinterpret_cast<const user_data_allocator::handle_t *>(
             &object.userData);
-    auto maybe_user_data = user_data.value().get(user_data_handle);
+    auto maybe_user_data = state().user_data.value().get(user_data_handle);
     if (maybe_user_data.okay()) {
         return maybe_user_data.release().id;
     } else {
@@ -259,7 +824,7 @@ template <typename T> bool errhandle(typename T::get_handle_err_code_e errcode)
 
 raw_body_t get_handle_from_body(const lib::body_t &body) noexcept
 {
-    auto res = bodies.value().get_handle_from_item(&body);
+    auto res = state().bodies.value().get_handle_from_item(&body);
     errhandle<body_allocator>(res.status());
     return res.release();
 }
@@ -267,7 +832,7 @@ raw_body_t get_handle_from_body(const lib::body_t &body) noexcept
 raw_segment_shape_t
 get_handle_from_segment_shape(const lib::segment_shape_t &shape) noexcept
 {
-    auto res = segment_shapes.value().get_handle_from_item(&shape);
+    auto res = state().segment_shapes.value().get_handle_from_item(&shape);
     errhandle<segment_shape_allocator>(res.status());
     return res.release();
 }
@@ -275,7 +840,7 @@ get_handle_from_segment_shape(const lib::segment_shape_t &shape) noexcept
 raw_poly_shape_t
 get_handle_from_polygon_shape(const lib::poly_shape_t &shape) noexcept
 {
-    auto res = poly_shapes.value().get_handle_from_item(&shape);
+    auto res = state().poly_shapes.value().get_handle_from_item(&shape);
     errhandle<poly_shape_allocator>(res.status());
     return res.release();
 }
@@ -283,7 +848,43 @@ get_handle_from_polygon_shape(const lib::poly_shape_t &shape) noexcept
 void add_collision_handler(const cpCollisionHandler &handler) noexcept
 {
     cpCollisionHandler *new_handler = cpSpaceAddCollisionHandler(
-        &space.value(), handler.typeA, handler.typeB);
+        &state().space.value(), handler.typeA, handler.typeB);
+#ifdef CROSSWIRE_PHYSICS_STATS
+    // handlers for types that can't be counted are added as they are
+    if (new_handler->typeA < size_t(collision_type_e::MAX) &&
+        new_handler->typeB < size_t(collision_type_e::MAX)) {
+        auto &counted = state()
+                            .counted_handlers[new_handler->typeA]
+                                             [new_handler->typeB];
+        // the first time around, keep chipmunk's defaults for the callbacks
+        // that aren't given
+        if (new_handler->beginFunc != counted_begin) {
+            counted = counted_handler_t{
+                .begin = new_handler->beginFunc,
+                .pre_solve = new_handler->preSolveFunc,
+                .post_solve = new_handler->postSolveFunc,
+                .separate = new_handler->separateFunc,
+                .user_data = new_handler->userData,
+            };
+            new_handler->beginFunc = counted_begin;
+            new_handler->preSolveFunc = counted_pre_solve;
+            new_handler->postSolveFunc = counted_post_solve;
+            new_handler->separateFunc = counted_separate;
+            new_handler->userData = &counted;
+        }
+        if (handler.postSolveFunc)
+            counted.post_solve = handler.postSolveFunc;
+        if (handler.preSolveFunc)
+            counted.pre_solve = handler.preSolveFunc;
+        if (handler.userData)
+            counted.user_data = handler.userData;
+        if (handler.beginFunc)
+            counted.begin = handler.beginFunc;
+        if (handler.separateFunc)
+            counted.separate = handler.separateFunc;
+        return;
+    }
+#endif
     if (handler.postSolveFunc)
         new_handler->postSolveFunc = handler.postSolveFunc;
     if (handler.preSolveFunc)
@@ -300,7 +901,7 @@ void add_collision_handler_wildcard(
     const collision_handler_wildcard_options_t &options) noexcept
 {
     cpCollisionHandler *new_handler = cpSpaceAddWildcardHandler(
-        &space.value(), (cpCollisionType)options.typeA);
+        &state().space.value(), (cpCollisionType)options.typeA);
     if (options.postSolveFunc)
         new_handler->postSolveFunc = options.postSolveFunc;
     if (options.preSolveFunc)
@@ -314,79 +915,267 @@ void add_collision_handler_wildcard(
 }
 
 /// Move all physics objects and potentially call collision handlers
-void update(float timestep) noexcept { space.value().step(timestep); }
-
-void debug_draw_all_shapes() noexcept
-{
-    float hue = 0;
-    constexpr float hue_increment = 10.0f;
-
-    auto color_for_type = [](game_id_e id) -> lib::opt_t<Color> {
-        switch (id) {
-        case cw::game_id_e::Player:
-            return ::GREEN;
-            break;
-        case cw::game_id_e::Bullet:
-            return ::RED;
-            break;
-        case cw::game_id_e::Terrain_Ditch:
-            return ::BROWN;
-            break;
-        case cw::game_id_e::Terrain_Obstacle:
-            return ::BLACK;
-            break;
-        default:
-            return {};
-        }
+void update(float timestep) noexcept
+{
+#ifdef CROSSWIRE_PHYSICS_STATS
+    const auto start = std::chrono::steady_clock::now();
+    state().last_stats = {};
+#endif
+    state().events.value().clear();
+    // pick up anything deferred by callbacks which ran outside of a step, for
+    // example separate callbacks triggered by removing a shape. after clearing
+    // the events, so that the ones raised by applying them are kept.
+    flush_deferred();
+    record_previous_positions();
+    state().space.value().step(timestep);
+    flush_deferred();
+    refresh_body_mirror();
+#ifdef CROSSWIRE_PHYSICS_STATS
+    gather_space_stats(state().last_stats);
+    state().last_stats.step_seconds = std::chrono::duration<double>(
+                                  std::chrono::steady_clock::now() - start)
+                                  .count();
+#endif
+}
+
+lib::vect_t interpolated_position(raw_body_t handle, float alpha) noexcept
+{
+    const lib::body_t &body = get_body(handle);
+    const lib::vect_t previous = previous_position_of(handle, body);
+    return previous + ((body.position() - previous) * alpha);
+}
+
+body_mirror_t dynamic_bodies() noexcept
+{
+    const auto &mirror = state().body_mirror.value();
+    return body_mirror_t{
+        .x = mirror.x,
+        .y = mirror.y,
+        .previous_x = mirror.previous_x,
+        .previous_y = mirror.previous_y,
+        .vx = mirror.vx,
+        .vy = mirror.vy,
+        .id = mirror.id,
+        .handle = mirror.handle,
     };
+}
 
-    for (lib::poly_shape_t &shape : poly_shapes.value()) {
-        assert(shape.count() > 1);
-        lib::vect_t verts[shape.count() + 1];
-        for (int i = 0; i < shape.count(); ++i) {
-            verts[i] =
-                shape.parent_cast()->body()->position() + shape.vertex(i);
-        }
-        verts[shape.count()] =
-            shape.parent_cast()->body()->position() + shape.vertex(0);
-        ::Color col = ColorFromHSV(hue, 1, 1);
-
-        auto id_res = get_physics_id(*shape.parent_cast());
-        if (id_res.okay()) {
-            if (auto color = color_for_type(id_res.release())) {
-                col = color.value();
+void update_activation(lib::vect_t center, float radius) noexcept
+{
+    if (state().space.value().is_locked()) [[unlikely]] {
+        LN_WARN("Attempt to update physics activation from inside a "
+                "collision callback, ignoring");
+        return;
+    }
+
+    auto &activation = state().activation.value();
+    activation.center = center;
+    activation.radius = radius;
+    activation.to_sleep.clear();
+    activation.to_wake.clear();
+
+    cpSpaceEachBody(
+        &state().space.value(),
+        [](cpBody *raw_body, void *data) {
+            auto &activation = *static_cast<activation_state_t *>(data);
+            auto *body = lib::body_t::from_chipmunk(raw_body);
+            if (body->type() != lib::body_t::Type::DYNAMIC ||
+                is_disabled_body(*body))
+                return;
+            const bool inside = body->position().dist_sq(activation.center) <=
+                                activation.radius * activation.radius;
+            const bool sleeping = body->is_sleeping();
+            if (inside && sleeping) {
+                activation.to_wake.push_back(body);
+            } else if (!inside && !sleeping) {
+                activation.to_sleep.push_back(body);
             }
-        }
+        },
+        &activation);
 
-        DrawLineStrip(verts, shape.count() + 1, col);
-        hue += hue_increment;
-        if (hue > 360.0f)
-            hue = 0;
+    for (lib::body_t *body : activation.to_wake) {
+        body->activate();
+    }
+    for (lib::body_t *body : activation.to_sleep) {
+        body->sleep();
     }
+}
+
+bool is_in_active_region(lib::vect_t point) noexcept
+{
+    const auto &activation = state().activation.value();
+    return point.dist_sq(activation.center) <=
+           activation.radius * activation.radius;
+}
 
-    for (lib::segment_shape_t &shape : segment_shapes.value()) {
-        ::Color col = ColorFromHSV(hue, 1, 1);
+const stats_t &stats() noexcept { return state().last_stats; }
 
-        auto id_res = get_physics_id(*shape.parent_cast());
-        if (id_res.okay()) {
-            if (auto color = color_for_type(id_res.release())) {
-                col = color.value();
-            }
+lib::slice_t<const collision_event_t> collision_events() noexcept
+{
+    return state().events.value();
+}
+
+/// Record the generation of every slot in use in a pool
+template <typename allocator_t>
+static void save_occupancy(allocator_t &allocator,
+                           pool_occupancy_t &out) noexcept
+{
+    out.generations.assign(allocator.capacity(), invalid_generation);
+    out.size = 0;
+    for (auto &item : allocator) {
+        auto handle = allocator.get_handle_from_item(&item);
+        if (!handle.okay()) [[unlikely]]
+            continue;
+        const auto raw = handle.release();
+        out.generations[raw.index()] = raw.generation();
+        ++out.size;
+    }
+}
+
+/// Whether exactly the same slots of a pool are in use, by the same
+/// generations, as when save_occupancy() was called
+template <typename allocator_t>
+static bool same_occupancy(allocator_t &allocator,
+                           const pool_occupancy_t &saved) noexcept
+{
+    size_t size = 0;
+    for (auto &item : allocator) {
+        auto handle = allocator.get_handle_from_item(&item);
+        if (!handle.okay()) [[unlikely]]
+            return false;
+        const auto raw = handle.release();
+        if (raw.index() >= saved.generations.size() ||
+            saved.generations[raw.index()] != raw.generation())
+            return false;
+        ++size;
+    }
+    return size == saved.size;
+}
+
+void save_snapshot(snapshot_t &snapshot) noexcept
+{
+    if (state().space.value().is_locked()) [[unlikely]] {
+        LN_FATAL("Attempt to save a physics snapshot from inside a collision "
+                 "callback");
+        std::abort();
+    }
+    flush_deferred();
+
+    snapshot.bodies.clear();
+    save_occupancy(state().bodies.value(), snapshot.body_pool);
+    save_occupancy(state().poly_shapes.value(), snapshot.poly_shape_pool);
+    save_occupancy(state().segment_shapes.value(),
+                   snapshot.segment_shape_pool);
+
+    // go through the space instead of the pool so that sleeping bodies are
+    // included and the space's own static body is not
+    cpSpaceEachBody(
+        &state().space.value(),
+        [](cpBody *raw_body, void *data) {
+            auto &out = *static_cast<std::vector<body_state_t> *>(data);
+            auto *body = lib::body_t::from_chipmunk(raw_body);
+            auto handle = state().bodies.value().get_handle_from_item(body);
+            if (!handle.okay())
+                return;
+            out.push_back(body_state_t{
+                .handle = handle.release(),
+                .position = body->position(),
+                .velocity = body->velocity(),
+                .force = body->force(),
+                .angle = body->angle(),
+                .angular_velocity = float(cpBodyGetAngularVelocity(body)),
+                .torque = body->torque(),
+            });
+        },
+        &snapshot.bodies);
+}
+
+bool restore_snapshot(const snapshot_t &snapshot) noexcept
+{
+    if (state().space.value().is_locked()) [[unlikely]] {
+        LN_FATAL("Attempt to restore a physics snapshot from inside a "
+                 "collision callback");
+        std::abort();
+    }
+    flush_deferred();
+
+    bool unchanged =
+        same_occupancy(state().bodies.value(), snapshot.body_pool) &&
+        same_occupancy(state().poly_shapes.value(), snapshot.poly_shape_pool) &&
+        same_occupancy(state().segment_shapes.value(),
+                       snapshot.segment_shape_pool);
+
+    auto &previous = state().previous_positions.value();
+    for (const auto &body_state : snapshot.bodies) {
+        auto res = state().bodies.value().get(body_state.handle);
+        if (!res.okay()) {
+            unchanged = false;
+            continue;
         }
+        // it's teleporting, so don't interpolate from where it was
+        if (body_state.handle.index() < previous.size())
+            previous[body_state.handle.index()].generation = invalid_generation;
+        auto &body = res.release();
+        body.set_position(body_state.position);
+        body.set_velocity(body_state.velocity);
+        body.set_force(body_state.force);
+        body.set_angle(body_state.angle);
+        cpBodySetAngularVelocity(&body, body_state.angular_velocity);
+        body.set_torque(body_state.torque);
+        // static bodies need their shapes' bounding boxes updated manually
+        if (body.type() == lib::body_t::Type::STATIC && body.space != nullptr) {
+            cpSpaceReindexShapesForBody(&state().space.value(), &body);
+            state().debug_draw_cache.value().static_dirty = true;
+        }
+    }
+
+    // so that dynamic_bodies() reflects the restored state right away
+    refresh_body_mirror();
+
+    if (!unchanged) {
+        LN_WARN("Restored a physics snapshot into a space whose bodies or "
+                "shapes have changed since the snapshot was taken");
+    }
+    return unchanged;
+}
 
-        DrawLineV(shape.parent_cast()->body()->position() + shape.a(),
-                  shape.parent_cast()->body()->position() + shape.b(), col);
+void debug_draw_all_shapes(float alpha) noexcept
+{
+    auto &cache = state().debug_draw_cache.value();
+
+    if (cache.static_dirty) {
+        cache.static_lines.clear();
+        for (lib::segment_shape_t &shape : state().segment_shapes.value()) {
+            if (is_static(*shape.parent_cast()))
+                emit_debug_lines(cache.static_lines, shape, 1);
+        }
+        for (lib::poly_shape_t &shape : state().poly_shapes.value()) {
+            if (is_static(*shape.parent_cast()))
+                emit_debug_lines(cache.static_lines, shape, 1);
+        }
+        cache.static_dirty = false;
+    }
 
-        hue += hue_increment;
-        if (hue > 360.0f)
-            hue = 0;
+    cache.dynamic_lines.clear();
+    for (lib::segment_shape_t &shape : state().segment_shapes.value()) {
+        if (!is_static(*shape.parent_cast()) &&
+            !is_disabled_body(*shape_body(*shape.parent_cast())))
+            emit_debug_lines(cache.dynamic_lines, shape, alpha);
+    }
+    for (lib::poly_shape_t &shape : state().poly_shapes.value()) {
+        if (!is_static(*shape.parent_cast()) &&
+            !is_disabled_body(*shape_body(*shape.parent_cast())))
+            emit_debug_lines(cache.dynamic_lines, shape, alpha);
     }
+
+    submit_debug_lines(cache.static_lines);
+    submit_debug_lines(cache.dynamic_lines);
 }
 
 raw_body_t create_body(game_id_e id,
                        const lib::body_t::body_options_t &options) noexcept
 {
-    auto stock_handle = bodies.value().alloc_new(options);
+    auto stock_handle = state().bodies.value().alloc_new(options);
 
     if (!stock_handle.okay()) [[unlikely]] {
         LN_FATAL_FMT("Failed to allocate physics body due to errcode {}",
@@ -396,9 +1185,13 @@ raw_body_t create_body(game_id_e id,
 
     auto handle = stock_handle.release();
 
-    auto body_lookup = bodies.value().get(handle);
+    auto body_lookup = state().bodies.value().get(handle);
     lib::body_t &body = body_lookup.release();
-    space.value().add(body);
+    if (state().space.value().is_locked() || state().batch_depth > 0) {
+        state().deferred.value().bodies_to_add.push_back(handle);
+    } else {
+        state().space.value().add(body);
+    }
 
     set_physics_id(body, id);
 
@@ -407,11 +1200,11 @@ raw_body_t create_body(game_id_e id,
 
 static lib::body_t &lookup_body(const raw_body_t &body_handle)
 {
-    auto body_res = bodies.value().get(body_handle);
+    auto body_res = state().bodies.value().get(body_handle);
 
     if (!body_res.okay()) [[unlikely]] {
         if (body_handle == get_static_body()) [[likely]] {
-            auto *static_body = space.value().get_static_body();
+            auto *static_body = state().space.value().get_static_body();
             assert(static_body);
             return *static_body;
         }
@@ -429,7 +1222,7 @@ create_segment_shape(const raw_body_t &body_handle,
                      const lib::segment_shape_t::options_t &options) noexcept
 {
     auto &body = lookup_body(body_handle);
-    auto stock_handle = segment_shapes.value().alloc_new(body, options);
+    auto stock_handle = state().segment_shapes.value().alloc_new(body, options);
 
     if (!stock_handle.okay()) [[unlikely]] {
         LN_FATAL_FMT("Failed to allocate physics body due to errcode {}",
@@ -438,19 +1231,83 @@ create_segment_shape(const raw_body_t &body_handle,
     }
 
     auto handle = stock_handle.release();
-    auto shape_lookup = segment_shapes.value().get(handle);
+    auto shape_lookup = state().segment_shapes.value().get(handle);
     lib::segment_shape_t &shape = shape_lookup.release();
-    space.value().add(*shape.parent_cast());
+    mark_debug_geometry_changed(*shape.parent_cast());
+    if (state().space.value().is_locked() || state().batch_depth > 0) {
+        state().deferred.value().segment_shapes_to_add.push_back(handle);
+    } else {
+        state().space.value().add(*shape.parent_cast());
+    }
 
     shape.parent_cast()->userData = body.userData;
 
     return handle;
 }
 
+void create_segment_chain(const raw_body_t &body_handle,
+                          lib::slice_t<const lib::vect_t> vertices,
+                          const segment_chain_options_t &options,
+                          std::vector<raw_segment_shape_t> &out) noexcept
+{
+    const size_t vertex_count = vertices.size();
+    if (vertex_count < 2) [[unlikely]] {
+        LN_ERROR("Attempt to create a segment chain with less than two "
+                 "vertices");
+        return;
+    }
+    // a closed chain of two vertices would just be the same segment twice
+    const bool closed = options.closed && vertex_count > 2;
+    const size_t segment_count = closed ? vertex_count : vertex_count - 1;
+
+    const auto vertex = [&vertices, vertex_count](size_t index) {
+        return vertices.data()[index % vertex_count];
+    };
+
+    // allocate everything first, since allocating may move the pool
+    auto &body = lookup_body(body_handle);
+    const size_t first = out.size();
+    out.reserve(first + segment_count);
+    for (size_t i = 0; i < segment_count; ++i) {
+        auto stock_handle = state().segment_shapes.value().alloc_new(
+            body, lib::segment_shape_t::options_t{
+                      .collision_type = options.collision_type,
+                      .a = vertex(i),
+                      .b = vertex(i + 1),
+                      .radius = options.radius,
+                  });
+        if (!stock_handle.okay()) [[unlikely]] {
+            LN_FATAL_FMT("Failed to allocate physics body due to errcode {}",
+                         fmt::underlying(stock_handle.status()));
+            std::abort();
+        }
+        out.push_back(stock_handle.release());
+    }
+
+    const bool deferred =
+        state().space.value().is_locked() || state().batch_depth > 0;
+    for (size_t i = 0; i < segment_count; ++i) {
+        const auto handle = out[first + i];
+        auto &shape = get_segment_shape(handle);
+        // ends of an open chain have no neighbor, so they use themselves
+        const bool is_first = i == 0 && !closed;
+        const bool is_last = i + 1 == segment_count && !closed;
+        shape.set_neighbors(is_first ? vertex(i) : vertex(i + vertex_count - 1),
+                            is_last ? vertex(i + 1) : vertex(i + 2));
+        shape.parent_cast()->userData = body.userData;
+        mark_debug_geometry_changed(*shape.parent_cast());
+        if (deferred) [[unlikely]] {
+            state().deferred.value().segment_shapes_to_add.push_back(handle);
+        } else {
+            state().space.value().add(*shape.parent_cast());
+        }
+    }
+}
+
 auto poly_shape_impl = [](const raw_body_t &body_handle,
                           auto options) -> raw_poly_shape_t {
     auto &body = lookup_body(body_handle);
-    auto stock_handle = poly_shapes.value().alloc_new(body, options);
+    auto stock_handle = state().poly_shapes.value().alloc_new(body, options);
 
     if (!stock_handle.okay()) [[unlikely]] {
         LN_FATAL_FMT("Failed to allocate physics body due to errcode {}",
@@ -459,9 +1316,14 @@ auto poly_shape_impl = [](const raw_body_t &body_handle,
     }
 
     auto handle = stock_handle.release();
-    auto shape_lookup = poly_shapes.value().get(handle);
+    auto shape_lookup = state().poly_shapes.value().get(handle);
     lib::poly_shape_t &shape = shape_lookup.release();
-    space.value().add(*shape.parent_cast());
+    mark_debug_geometry_changed(*shape.parent_cast());
+    if (state().space.value().is_locked() || state().batch_depth > 0) {
+        state().deferred.value().poly_shapes_to_add.push_back(handle);
+    } else {
+        state().space.value().add(*shape.parent_cast());
+    }
 
     shape.parent_cast()->userData = body.userData;
 
@@ -486,7 +1348,7 @@ raw_poly_shape_t create_polygon_shape(
 
 lib::body_t &get_body(raw_body_t handle) noexcept
 {
-    auto body_res = bodies.value().get(handle);
+    auto body_res = state().bodies.value().get(handle);
     if (!body_res.okay()) {
         LN_FATAL("Failed to get body from physics::get_body");
         std::abort();
@@ -496,7 +1358,7 @@ lib::body_t &get_body(raw_body_t handle) noexcept
 
 lib::segment_shape_t &get_segment_shape(raw_segment_shape_t handle) noexcept
 {
-    auto segment_shape_res = segment_shapes.value().get(handle);
+    auto segment_shape_res = state().segment_shapes.value().get(handle);
     if (!segment_shape_res.okay()) {
         LN_FATAL("Failed to get segment shape from physics::get_segment_shape");
         std::abort();
@@ -506,7 +1368,7 @@ lib::segment_shape_t &get_segment_shape(raw_segment_shape_t handle) noexcept
 
 lib::poly_shape_t &get_polygon_shape(raw_poly_shape_t handle) noexcept
 {
-    auto poly_shape_res = poly_shapes.value().get(handle);
+    auto poly_shape_res = state().poly_shapes.value().get(handle);
     if (!poly_shape_res.okay()) {
         LN_FATAL("Failed to get polygon shape from physics::get_polygon_shape");
         std::abort();
@@ -516,36 +1378,40 @@ lib::poly_shape_t &get_polygon_shape(raw_poly_shape_t handle) noexcept
 
 void delete_segment_shape(raw_segment_shape_t handle) noexcept
 {
-    auto maybe_shape = segment_shapes.value().get(handle);
+    auto maybe_shape = state().segment_shapes.value().get(handle);
     if (!maybe_shape.okay()) [[unlikely]] {
         LN_WARN("attempt to free invalid segment shape");
         return;
     }
+    auto &shape = maybe_shape.release();
+    mark_debug_geometry_changed(*shape.parent_cast());
 
-    space.value().remove(*maybe_shape.release().parent_cast());
-
-    auto status = segment_shapes.value().free(handle);
-    if (!status.okay()) [[unlikely]] {
-        LN_WARN_FMT("Failed to free segment shape with errcode {}",
-                    fmt::underlying(status.status()));
+    if (state().space.value().is_locked() || state().batch_depth > 0) {
+        state().deferred.value().segment_shapes_to_delete.push_back(handle);
+        return;
     }
+
+    remove_from_space(shape);
+    free_from_pool(state().segment_shapes.value(), handle);
 }
 
 void delete_polygon_shape(raw_poly_shape_t handle) noexcept
 {
-    auto maybe_shape = poly_shapes.value().get(handle);
+    auto maybe_shape = state().poly_shapes.value().get(handle);
     if (!maybe_shape.okay()) [[unlikely]] {
         LN_WARN("Attempt to free invalid polygon shape");
         return;
     }
+    auto &shape = maybe_shape.release();
+    mark_debug_geometry_changed(*shape.parent_cast());
 
-    space.value().remove(*maybe_shape.release().parent_cast());
-
-    auto status = poly_shapes.value().free(handle);
-    if (!status.okay()) [[unlikely]] {
-        LN_WARN_FMT("Failed to free polygon shape with errcode {}",
-                    fmt::underlying(status.status()));
+    if (state().space.value().is_locked() || state().batch_depth > 0) {
+        state().deferred.value().poly_shapes_to_delete.push_back(handle);
+        return;
     }
+
+    remove_from_space(shape);
+    free_from_pool(state().poly_shapes.value(), handle);
 }
 
 void delete_body(raw_body_t handle) noexcept
@@ -556,21 +1422,598 @@ void delete_body(raw_body_t handle) noexcept
         return;
     }
 
-    auto maybe_body = bodies.value().get(handle);
+    auto maybe_body = state().bodies.value().get(handle);
     if (!maybe_body.okay()) [[unlikely]] {
         LN_WARN("Attempt to free invalid body");
         return;
     }
 
+    if (state().space.value().is_locked() || state().batch_depth > 0) {
+        state().deferred.value().bodies_to_delete.push_back(handle);
+        return;
+    }
+
+    remove_from_space(maybe_body.release());
+    free_from_pool(state().bodies.value(), handle);
+}
+
+/// Queue every shape for which matches() returns true for deletion, and then
+/// apply the deletions in bulk with flush_deferred().
+template <typename allocator_t, typename predicate_t>
+static size_t
+queue_matching_shapes(allocator_t &allocator,
+                      std::vector<typename allocator_t::handle_t> &out,
+                      predicate_t &&matches) noexcept
+{
+    size_t count = 0;
+    for (auto &shape : allocator) {
+        if (!matches(*shape.parent_cast()))
+            continue;
+        auto handle = allocator.get_handle_from_item(&shape);
+        if (!handle.okay()) [[unlikely]] {
+            LN_WARN("Failed to get handle for shape during bulk deletion");
+            continue;
+        }
+        mark_debug_geometry_changed(*shape.parent_cast());
+        out.push_back(handle.release());
+        ++count;
+    }
+    return count;
+}
+
+/// Apply bulk deletions queued by queue_matching_shapes(), unless we're inside
+/// a step or a batch, in which case update() or end_batch() does it
+static void finish_bulk_delete() noexcept
+{
+    if (state().space.value().is_locked() || state().batch_depth > 0)
+        return;
+    flush_deferred();
+}
+
+void begin_batch() noexcept { ++state().batch_depth; }
+
+void end_batch() noexcept
+{
+    auto &depth = state().batch_depth;
+    if (depth == 0) [[unlikely]] {
+        LN_WARN("end_batch() called without begin_batch()");
+        return;
+    }
+    --depth;
+    // inside a step, update() applies the changes once it's done
+    if (depth == 0 && !state().space.value().is_locked())
+        flush_deferred();
+}
+
+template <typename allocator_t>
+static void reserve_in_pool(allocator_t &allocator, size_t count) noexcept
+{
+    if (!allocator.reserve(count).okay()) [[unlikely]] {
+        LN_FATAL_FMT("Failed to reserve space for {} physics objects", count);
+        std::abort();
+    }
+}
+
+void reserve(size_t bodies, size_t poly_shapes, size_t segment_shapes) noexcept
+{
+    reserve_in_pool(state().bodies.value(), bodies);
+    reserve_in_pool(state().poly_shapes.value(), poly_shapes);
+    reserve_in_pool(state().segment_shapes.value(), segment_shapes);
+    reserve_in_pool(state().user_data.value(),
+                    bodies + poly_shapes + segment_shapes);
+}
+
+static void set_filter_of_shapes(lib::body_t &body,
+                                 cpShapeFilter filter) noexcept
+{
+    cpBodyEachShape(
+        &body,
+        [](cpBody *, cpShape *shape, void *data) {
+            cpShapeSetFilter(shape, *static_cast<cpShapeFilter *>(data));
+        },
+        &filter);
+}
+
+/// Velocity update for disabled bodies: no gravity, no damping, nothing
+static void hold_velocity(cpBody *, cpVect, cpFloat, cpFloat) noexcept {}
+
+/// Position update for disabled bodies. Doesn't move the body, and resets its
+/// idle time every step so that chipmunk never puts it to sleep, which would
+/// move its shapes into the static index and back out again when it's enabled.
+static void hold_position(cpBody *body, cpFloat) noexcept
+{
+    body->sleeping.idleTime = 0;
+}
+
+void disable(raw_body_t handle) noexcept
+{
+    auto maybe_body = state().bodies.value().get(handle);
+    if (!maybe_body.okay()) [[unlikely]] {
+        LN_WARN("Attempt to disable invalid body");
+        return;
+    }
+    auto &body = maybe_body.release();
+    if (body.type() != lib::body_t::Type::DYNAMIC) [[unlikely]] {
+        LN_WARN("Attempt to disable a body which is not dynamic, ignoring");
+        return;
+    }
+
+    auto &disabled = state().disabled_generations.value();
+    if (disabled.size() <= handle.index())
+        disabled.resize(handle.index() + 1, invalid_generation);
+    disabled[handle.index()] = handle.generation();
+
+    set_filter_of_shapes(body, CP_SHAPE_FILTER_NONE);
+    body.set_velocity(lib::vect_t::zero());
+    cpBodySetVelocityUpdateFunc(&body, hold_velocity);
+    cpBodySetPositionUpdateFunc(&body, hold_position);
+}
+
+void enable(raw_body_t handle, lib::vect_t position,
+            lib::vect_t velocity) noexcept
+{
+    auto maybe_body = state().bodies.value().get(handle);
+    if (!maybe_body.okay()) [[unlikely]] {
+        LN_WARN("Attempt to enable invalid body");
+        return;
+    }
     auto &body = maybe_body.release();
+    if (!is_disabled_body(handle)) [[unlikely]] {
+        LN_WARN("Attempt to enable a body which was not disabled, ignoring");
+        return;
+    }
+    state().disabled_generations.value()[handle.index()] = invalid_generation;
+    // it's teleporting, so don't interpolate from where it was disabled
+    auto &previous = state().previous_positions.value();
+    if (handle.index() < previous.size())
+        previous[handle.index()].generation = invalid_generation;
+
+    // moving a sleeping body wakes it up, or queues it to be woken at the end
+    // of the step if the space is locked. it can only be asleep if it already
+    // was when it got disabled.
+    body.set_position(position);
+    body.set_velocity(velocity);
+    cpBodySetVelocityUpdateFunc(&body, cpBodyUpdateVelocity);
+    cpBodySetPositionUpdateFunc(&body, cpBodyUpdatePosition);
+    set_filter_of_shapes(body, CP_SHAPE_FILTER_ALL);
+}
 
-    space.value().remove(body);
+bool is_disabled(raw_body_t handle) noexcept
+{
+    return is_disabled_body(handle);
+}
 
-    auto status = bodies.value().free(handle);
-    if (!status.okay()) [[unlikely]] {
-        LN_WARN_FMT("Failed to free physics body with errcode {}",
-                    fmt::underlying(status.status()));
+size_t delete_all_with_id(game_id_e id) noexcept
+{
+    game_id_set_t ids;
+    ids.set(size_t(id));
+    return delete_all_with_ids(ids);
+}
+
+size_t delete_all_with_ids(const game_id_set_t &ids) noexcept
+{
+    auto &commands = state().deferred.value();
+    auto matches = [&ids](const auto &object) {
+        auto object_id = get_id(object);
+        return object_id.has_value() && ids.test(size_t(object_id.value()));
+    };
+
+    size_t count = 0;
+    count += queue_matching_shapes(state().poly_shapes.value(),
+                                   commands.poly_shapes_to_delete, matches);
+    count += queue_matching_shapes(state().segment_shapes.value(),
+                                   commands.segment_shapes_to_delete, matches);
+
+    const raw_body_t static_body = get_static_body();
+    for (auto &body : state().bodies.value()) {
+        if (!matches(body))
+            continue;
+        auto handle = state().bodies.value().get_handle_from_item(&body);
+        if (!handle.okay()) [[unlikely]] {
+            LN_WARN("Failed to get handle for body during bulk deletion");
+            continue;
+        }
+        auto raw = handle.release();
+        if (raw == static_body)
+            continue;
+        commands.bodies_to_delete.push_back(raw);
+        ++count;
+    }
+
+    finish_bulk_delete();
+    return count;
+}
+
+size_t delete_all_with_collision_type(collision_type_e type) noexcept
+{
+    auto &commands = state().deferred.value();
+    auto matches = [type](lib::shape_t &shape) {
+        return shape.collision_type() == cpCollisionType(type);
+    };
+
+    size_t count = 0;
+    count += queue_matching_shapes(state().poly_shapes.value(),
+                                   commands.poly_shapes_to_delete, matches);
+    count += queue_matching_shapes(state().segment_shapes.value(),
+                                   commands.segment_shapes_to_delete, matches);
+
+    finish_bulk_delete();
+    return count;
+}
+
+/// State passed through chipmunk's void* while running a query
+struct query_context_t
+{
+    query_filter_t filter;
+    /// Buffer for the queries that return many results. May be null
+    query_hit_t *out;
+    size_t out_size;
+    size_t count;
+    /// Used by the queries that only want one result
+    lib::opt_t<query_hit_t> best;
+};
+
+static bool query_accepts(query_filter_t filter, const lib::shape_t &shape)
+{
+    const auto type = shape.type;
+    return type < sizeof(query_filter_t) * 8 &&
+           (filter & (query_filter_t(1) << type)) != 0;
+}
+
+static query_hit_t make_hit(cpShape *shape, lib::vect_t point,
+                            lib::vect_t normal, float distance) noexcept
+{
+    auto *lib_shape = static_cast<lib::shape_t *>(shape);
+    auto id = get_id(*lib_shape);
+    return query_hit_t{
+        .shape = lib_shape,
+        .id = id.has_value() ? id.value() : game_id_e::NULLP,
+        .collision_type = lib_shape->type,
+        .point = point,
+        .normal = normal,
+        .distance = distance,
+    };
+}
+
+static void push_hit(query_context_t &context, const query_hit_t &hit) noexcept
+{
+    if (context.count >= context.out_size)
+        return;
+    context.out[context.count] = hit;
+    ++context.count;
+}
+
+lib::slice_t<query_hit_t> query_segment(lib::vect_t start, lib::vect_t end,
+                                        float radius, query_filter_t filter,
+                                        lib::slice_t<query_hit_t> out) noexcept
+{
+    query_context_t context{
+        .filter = filter,
+        .out = out.data(),
+        .out_size = out.size(),
+        .count = 0,
+    };
+    cpSpaceSegmentQuery(
+        &state().space.value(), start, end, radius, CP_SHAPE_FILTER_ALL,
+        [](cpShape *shape, cpVect point, cpVect normal, cpFloat alpha,
+           void *data) {
+            auto &context = *static_cast<query_context_t *>(data);
+            if (!query_accepts(context.filter,
+                               *static_cast<lib::shape_t *>(shape)))
+                return;
+            push_hit(context, make_hit(shape, point, normal, alpha));
+        },
+        &context);
+    return {out, 0, context.count};
+}
+
+lib::opt_t<query_hit_t> query_segment_first(lib::vect_t start, lib::vect_t end,
+                                            float radius,
+                                            query_filter_t filter) noexcept
+{
+    // cpSpaceSegmentQueryFirst can only filter by category, so do it manually
+    query_context_t context{
+        .filter = filter,
+        .out = nullptr,
+        .out_size = 0,
+        .count = 0,
+    };
+    cpSpaceSegmentQuery(
+        &state().space.value(), start, end, radius, CP_SHAPE_FILTER_ALL,
+        [](cpShape *shape, cpVect point, cpVect normal, cpFloat alpha,
+           void *data) {
+            auto &context = *static_cast<query_context_t *>(data);
+            if (!query_accepts(context.filter,
+                               *static_cast<lib::shape_t *>(shape)))
+                return;
+            if (context.best.has_value() &&
+                context.best.value().distance <= alpha)
+                return;
+            context.best = make_hit(shape, point, normal, alpha);
+        },
+        &context);
+    return context.best;
+}
+
+lib::opt_t<query_hit_t> query_point_nearest(lib::vect_t point,
+                                            float max_distance,
+                                            query_filter_t filter) noexcept
+{
+    query_context_t context{
+        .filter = filter,
+        .out = nullptr,
+        .out_size = 0,
+        .count = 0,
+    };
+    cpSpacePointQuery(
+        &state().space.value(), point, max_distance, CP_SHAPE_FILTER_ALL,
+        [](cpShape *shape, cpVect point, cpFloat distance, cpVect gradient,
+           void *data) {
+            auto &context = *static_cast<query_context_t *>(data);
+            if (!query_accepts(context.filter,
+                               *static_cast<lib::shape_t *>(shape)))
+                return;
+            if (context.best.has_value() &&
+                context.best.value().distance <= distance)
+                return;
+            context.best = make_hit(shape, point, gradient, distance);
+        },
+        &context);
+    return context.best;
+}
+
+lib::slice_t<query_hit_t> query_bb(const lib::rect_t &box,
+                                   query_filter_t filter,
+                                   lib::slice_t<query_hit_t> out) noexcept
+{
+    query_context_t context{
+        .filter = filter,
+        .out = out.data(),
+        .out_size = out.size(),
+        .count = 0,
+    };
+    cpSpaceBBQuery(
+        &state().space.value(), box, CP_SHAPE_FILTER_ALL,
+        [](cpShape *shape, void *data) {
+            auto &context = *static_cast<query_context_t *>(data);
+            if (!query_accepts(context.filter,
+                               *static_cast<lib::shape_t *>(shape)))
+                return;
+            push_hit(context, make_hit(shape, {}, {}, 0));
+        },
+        &context);
+    return {out, 0, context.count};
+}
+
+static lib::slice_t<query_hit_t>
+query_shape_impl(lib::shape_t &shape, query_filter_t filter,
+                 lib::slice_t<query_hit_t> out) noexcept
+{
+    query_context_t context{
+        .filter = filter,
+        .out = out.data(),
+        .out_size = out.size(),
+        .count = 0,
+    };
+    cpSpaceShapeQuery(
+        &state().space.value(), &shape,
+        [](cpShape *shape, cpContactPointSet *points, void *data) {
+            auto &context = *static_cast<query_context_t *>(data);
+            if (!query_accepts(context.filter,
+                               *static_cast<lib::shape_t *>(shape)))
+                return;
+            const bool has_points = points->count > 0;
+            push_hit(context,
+                     make_hit(shape,
+                              has_points ? lib::vect_t(points->points[0].pointB)
+                                         : lib::vect_t::zero(),
+                              points->normal,
+                              has_points ? points->points[0].distance : 0));
+        },
+        &context);
+    return {out, 0, context.count};
+}
+
+lib::slice_t<query_hit_t> query_shape(raw_poly_shape_t shape,
+                                      query_filter_t filter,
+                                      lib::slice_t<query_hit_t> out) noexcept
+{
+    return query_shape_impl(*get_polygon_shape(shape).parent_cast(), filter,
+                            out);
+}
+
+lib::slice_t<query_hit_t> query_shape(raw_segment_shape_t shape,
+                                      query_filter_t filter,
+                                      lib::slice_t<query_hit_t> out) noexcept
+{
+    return query_shape_impl(*get_segment_shape(shape).parent_cast(), filter,
+                            out);
+}
+
+/// Apply one set of deferred commands
+static void apply_deferred(deferred_commands_t &commands,
+                           bool warn_if_freed) noexcept
+{
+    // a handle may be deleted more than once from within callbacks, and sorting
+    // makes the pool accesses below go forwards through memory
+    sort_and_dedupe(commands.bodies_to_delete);
+    sort_and_dedupe(commands.poly_shapes_to_delete);
+    sort_and_dedupe(commands.segment_shapes_to_delete);
+
+    // bodies need to be in the space before their shapes
+    add_all_to_space(state().bodies.value(), commands.bodies_to_add);
+    add_all_to_space(state().poly_shapes.value(), commands.poly_shapes_to_add);
+    add_all_to_space(state().segment_shapes.value(),
+                     commands.segment_shapes_to_add);
+
+    remove_all_from_space(state().poly_shapes.value(),
+                          commands.poly_shapes_to_delete, warn_if_freed);
+    remove_all_from_space(state().segment_shapes.value(),
+                          commands.segment_shapes_to_delete, warn_if_freed);
+    remove_all_from_space(state().bodies.value(), commands.bodies_to_delete,
+                          warn_if_freed);
+
+    for (const auto &handle : commands.poly_shapes_to_delete) {
+        free_from_pool(state().poly_shapes.value(), handle);
+    }
+    for (const auto &handle : commands.segment_shapes_to_delete) {
+        free_from_pool(state().segment_shapes.value(), handle);
+    }
+    for (const auto &handle : commands.bodies_to_delete) {
+        free_from_pool(state().bodies.value(), handle);
+    }
+}
+
+void flush_deferred() noexcept
+{
+    if (state().space.value().is_locked()) [[unlikely]] {
+        LN_WARN("Attempt to flush deferred physics commands while the space is "
+                "locked, ignoring.");
+        return;
+    }
+
+    // removing shapes runs separate callbacks, which may queue more commands.
+    // swap the lists out so that doesn't disturb the ones being applied, and
+    // keep going until nothing new was queued.
+    auto &commands = state().deferred.value();
+    auto &flushing = state().flushing.value();
+    bool first = true;
+    while (!commands.empty()) {
+        std::swap(commands, flushing);
+        apply_deferred(flushing, first);
+        flushing.clear();
+        first = false;
     }
 }
 
 } // namespace cw::physics
+
+/// Get a handle to a body which may be the static body
+static cw::physics::raw_body_t handle_for_any_body(cpBody *body) noexcept
+{
+    if (body == cpSpaceGetStaticBody(&state().space.value())) {
+        return cw::physics::get_static_body();
+    }
+    return cw::physics::get_handle_from_body(*lib::body_t::from_chipmunk(body));
+}
+
+#ifdef CROSSWIRE_PHYSICS_STATS
+/// Add a collision callback to stats_t::handler_calls
+static void
+count_handler_call(cpArbiter *arb,
+                   cw::physics::collision_event_type_e type) noexcept
+{
+    cpShape *shape_a = nullptr;
+    cpShape *shape_b = nullptr;
+    cpArbiterGetShapes(arb, &shape_a, &shape_b);
+    for (cpCollisionType collision_type :
+         {cpShapeGetCollisionType(shape_a), cpShapeGetCollisionType(shape_b)}) {
+        if (collision_type < size_t(cw::physics::collision_type_e::MAX)) {
+            ++state().last_stats.handler_calls[size_t(type)][collision_type];
+        }
+    }
+}
+
+static cpBool counted_begin(cpArbiter *arb, cpSpace *space,
+                            cpDataPointer data) noexcept
+{
+    const auto &handler = *static_cast<counted_handler_t *>(data);
+    count_handler_call(arb, cw::physics::collision_event_type_e::Begin);
+    return handler.begin(arb, space, handler.user_data);
+}
+
+static cpBool counted_pre_solve(cpArbiter *arb, cpSpace *space,
+                                cpDataPointer data) noexcept
+{
+    const auto &handler = *static_cast<counted_handler_t *>(data);
+    return handler.pre_solve(arb, space, handler.user_data);
+}
+
+static void counted_post_solve(cpArbiter *arb, cpSpace *space,
+                               cpDataPointer data) noexcept
+{
+    const auto &handler = *static_cast<counted_handler_t *>(data);
+    count_handler_call(arb, cw::physics::collision_event_type_e::PostSolve);
+    handler.post_solve(arb, space, handler.user_data);
+}
+
+static void counted_separate(cpArbiter *arb, cpSpace *space,
+                             cpDataPointer data) noexcept
+{
+    const auto &handler = *static_cast<counted_handler_t *>(data);
+    count_handler_call(arb, cw::physics::collision_event_type_e::Separate);
+    handler.separate(arb, space, handler.user_data);
+}
+#endif
+
+static void record_event(cpArbiter *arb,
+                         cw::physics::collision_event_type_e type) noexcept
+{
+    using namespace cw;
+    if (!current_world().physics ||
+        !state().events.has_value()) [[unlikely]] {
+        LN_ERROR("Collision event recorded after physics::cleanup()");
+        return;
+    }
+
+    cpShape *shape_a = nullptr;
+    cpShape *shape_b = nullptr;
+    cpArbiterGetShapes(arb, &shape_a, &shape_b);
+    cpBody *body_a = nullptr;
+    cpBody *body_b = nullptr;
+    cpArbiterGetBodies(arb, &body_a, &body_b);
+
+    auto *lib_shape_a = static_cast<lib::shape_t *>(shape_a);
+    auto *lib_shape_b = static_cast<lib::shape_t *>(shape_b);
+
+#ifdef CROSSWIRE_PHYSICS_STATS
+    count_handler_call(arb, type);
+#endif
+
+    const bool post_solve = type == physics::collision_event_type_e::PostSolve;
+    const bool separate = type == physics::collision_event_type_e::Separate;
+
+    auto id_a = physics::get_id(*lib_shape_a);
+    auto id_b = physics::get_id(*lib_shape_b);
+
+    state().events.value().push_back(physics::collision_event_t{
+        .type = type,
+        .id_a = id_a.has_value() ? id_a.value() : game_id_e::NULLP,
+        .id_b = id_b.has_value() ? id_b.value() : game_id_e::NULLP,
+        .collision_type_a = lib_shape_a->collision_type(),
+        .collision_type_b = lib_shape_b->collision_type(),
+        .shape_a = lib_shape_a,
+        .shape_b = lib_shape_b,
+        .body_a = handle_for_any_body(body_a),
+        .body_b = handle_for_any_body(body_b),
+        .normal = separate ? lib::vect_t::zero()
+                           : lib::vect_t(cpArbiterGetNormal(arb)),
+        .impulse = post_solve ? lib::vect_t(cpArbiterTotalImpulse(arb))
+                              : lib::vect_t::zero(),
+    });
+}
+
+static cpBool record_begin(cpArbiter *arb, cpSpace *space,
+                           cpDataPointer) noexcept
+{
+    record_event(arb, cw::physics::collision_event_type_e::Begin);
+    const cpBool retA = cpArbiterCallWildcardBeginA(arb, space);
+    const cpBool retB = cpArbiterCallWildcardBeginB(arb, space);
+    return retA && retB;
+}
+
+static void record_post_solve(cpArbiter *arb, cpSpace *space,
+                              cpDataPointer) noexcept
+{
+    record_event(arb, cw::physics::collision_event_type_e::PostSolve);
+    cpArbiterCallWildcardPostSolveA(arb, space);
+    cpArbiterCallWildcardPostSolveB(arb, space);
+}
+
+static void record_separate(cpArbiter *arb, cpSpace *space,
+                            cpDataPointer) noexcept
+{
+    record_event(arb, cw::physics::collision_event_type_e::Separate);
+    cpArbiterCallWildcardSeparateA(arb, space);
+    cpArbiterCallWildcardSeparateB(arb, space);
+}
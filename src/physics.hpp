@@ -2,11 +2,17 @@
 #include "allo/pool_allocator_generational.hpp"
 #include "game_ids.hpp"
 #include "physics_collision_types.hpp"
+#include "physics_memory.hpp"
 #include "root_allocator.hpp"
 #include "thelib/body.hpp"
 #include "thelib/opt.hpp"
 #include "thelib/shape.hpp"
+#include "thelib/slice.hpp"
+#include <array>
+#include <bitset>
 #include <cstddef>
+#include <initializer_list>
+#include <vector>
 
 namespace cw::physics {
 
@@ -51,9 +57,183 @@ void init() noexcept;
 /// Delete all physics data
 void cleanup() noexcept;
 
-/// Move all physics objects and potentially call collision handlers
+/// Move all physics objects and potentially call collision handlers. Also
+/// applies any creations and deletions that were deferred because they happened
+/// inside of a collision callback.
 void update(float timestep) noexcept;
 
+/// Apply all deferred creations and deletions right now. Does nothing if called
+/// while the space is locked (ie. from within a collision callback). update()
+/// calls this, so you usually don't have to.
+void flush_deferred() noexcept;
+
+enum class collision_event_type_e : uint8_t
+{
+    /// Two shapes started touching this step
+    Begin,
+    /// Two shapes are touching and the solver has finished resolving them
+    PostSolve,
+    /// Two shapes stopped touching (or one of them was removed)
+    Separate,
+};
+inline constexpr size_t collision_event_type_count = 3;
+
+/// A copy of the interesting parts of a chipmunk arbiter, recorded during
+/// update() so that gameplay code can react to collisions after the step
+/// instead of inside of chipmunk callbacks.
+struct collision_event_t
+{
+    collision_event_type_e type;
+    /// game ids of both shapes, or game_id_e::NULLP if they had none
+    game_id_e id_a;
+    game_id_e id_b;
+    cpCollisionType collision_type_a;
+    cpCollisionType collision_type_b;
+    /// The shapes involved. Only valid until the shape is deleted.
+    lib::shape_t *shape_a;
+    lib::shape_t *shape_b;
+    /// Handles to the bodies of the shapes. May be equal to get_static_body()
+    raw_body_t body_a;
+    raw_body_t body_b;
+    /// Collision normal pointing from a to b. Zero for Separate events.
+    lib::vect_t normal;
+    /// Total impulse applied by the solver. Only nonzero for PostSolve events.
+    lib::vect_t impulse;
+};
+
+/// Get all of the collision events recorded during the last call to update().
+/// Events are only recorded for collisions which do not have a specific
+/// handler added with add_collision_handler(). Separate events caused by
+/// deleting shapes in between steps are appended to the end, and ones caused
+/// by deletions which are still deferred when update() runs are kept in that
+/// update's events. The slice is invalidated by the next call to update().
+lib::slice_t<const collision_event_t> collision_events() noexcept;
+
+/// Occupancy of one of the physics object pools
+struct pool_stats_t
+{
+    size_t size;
+    size_t capacity;
+};
+
+/// Measurements taken during the most recent call to update(). Only filled out
+/// if the game is compiled with CROSSWIRE_PHYSICS_STATS, otherwise always zero.
+struct stats_t
+{
+    /// Wall clock time spent inside of update(), including deferred flushes
+    double step_seconds;
+    size_t active_bodies;
+    size_t sleeping_bodies;
+    size_t static_bodies;
+    size_t poly_shapes;
+    size_t segment_shapes;
+    size_t arbiters;
+    size_t contacts;
+    /// How many times the collision callbacks fired this step, indexed by
+    /// collision_event_type_e and then by collision type. Both types involved
+    /// in a collision are counted. Includes collisions with a handler added
+    /// with add_collision_handler() as well as ones that only go through the
+    /// wildcard handlers.
+    std::array<std::array<size_t, size_t(collision_type_e::MAX)>,
+               collision_event_type_count>
+        handler_calls;
+    pool_stats_t body_pool;
+    pool_stats_t poly_shape_pool;
+    pool_stats_t segment_shape_pool;
+    pool_stats_t user_data_pool;
+    /// Memory allocated by chipmunk itself
+    memory::stats_t internal_memory;
+};
+
+/// Read-only structure-of-arrays copy of every dynamic body in the space,
+/// taken at the end of the last call to update(). All of the slices have the
+/// same length and element i of each describes the same body. Sleeping bodies
+/// are included. Invalidated by the next call to update().
+struct body_mirror_t
+{
+    lib::slice_t<const float> x;
+    lib::slice_t<const float> y;
+    /// Position before the last step, for interpolation
+    lib::slice_t<const float> previous_x;
+    lib::slice_t<const float> previous_y;
+    lib::slice_t<const float> vx;
+    lib::slice_t<const float> vy;
+    /// game_id_e::NULLP for bodies without an id
+    lib::slice_t<const game_id_e> id;
+    lib::slice_t<const raw_body_t> handle;
+};
+
+[[nodiscard]] body_mirror_t dynamic_bodies() noexcept;
+
+/// The position of a body alpha of the way between where it was before the
+/// last step (alpha = 0) and where it is now (alpha = 1). For rendering in
+/// between fixed physics steps.
+[[nodiscard]] lib::vect_t interpolated_position(raw_body_t handle,
+                                                float alpha) noexcept;
+
+/// Put every dynamic body further than radius from center to sleep, and wake
+/// up every sleeping body within it, so that only the area around the player
+/// costs anything to simulate. Bodies asleep outside of the region still wake
+/// up if something awake runs into them. Call once per frame, before update().
+void update_activation(lib::vect_t center, float radius) noexcept;
+
+/// Whether a point is inside the region passed to the last call to
+/// update_activation(). Always true if it has never been called. For things
+/// which aren't physics bodies (like turrets) to pause themselves.
+bool is_in_active_region(lib::vect_t point) noexcept;
+
+/// Statistics about the last call to update()
+const stats_t &stats() noexcept;
+
+/// Saved motion of a single body
+struct body_state_t
+{
+    raw_body_t handle;
+    lib::vect_t position;
+    lib::vect_t velocity;
+    lib::vect_t force;
+    float angle;
+    float angular_velocity;
+    float torque;
+};
+
+/// Which slots of one of the physics object pools were in use when a snapshot
+/// was taken, and by which generation
+struct pool_occupancy_t
+{
+    /// Indexed by slot. invalid_generation for slots which were free.
+    std::vector<gen_t> generations;
+    /// Number of slots in use
+    size_t size;
+};
+
+/// The dynamic state of every body in the physics space, plus enough
+/// information about the pools to tell whether the world still has the same
+/// objects in it. Reuse the same snapshot between saves to avoid allocating.
+struct snapshot_t
+{
+    std::vector<body_state_t> bodies;
+    pool_occupancy_t body_pool;
+    pool_occupancy_t poly_shape_pool;
+    pool_occupancy_t segment_shape_pool;
+};
+
+/// Save the position, velocity, angle, and forces of every body into snapshot,
+/// overwriting its previous contents. Applies deferred creations and deletions
+/// first. Must not be called from inside a collision callback.
+void save_snapshot(snapshot_t &snapshot) noexcept;
+
+/// Put every body back into the state it was in when the snapshot was taken.
+/// Bodies and shapes are not recreated or destroyed: bodies which were deleted
+/// since the snapshot are skipped. Chipmunk's cached contacts are not saved, so
+/// resimulating from a snapshot may differ slightly for a step or two. Returns
+/// false if any body or shape was created or deleted since the snapshot was
+/// taken, even if one took the place of another in its pool, in which case
+/// everything that could be restored still was. Restored bodies
+/// are not interpolated from where they were before, and dynamic_bodies() is
+/// up to date as soon as this returns.
+bool restore_snapshot(const snapshot_t &snapshot) noexcept;
+
 /// Add a collision handler which triggers whenever a certain two kinds of shape
 /// collide.
 ///
@@ -76,6 +256,9 @@ void update(float timestep) noexcept;
 /// separateFunc: Function that gets called whenever two bodies stop colliding.
 /// According to chipmunk docs, it is guaranteed to always be called in even
 /// amounts with the beginFunc.
+///
+/// With CROSSWIRE_PHYSICS_STATS, the callbacks are called through wrappers
+/// which count them in stats_t::handler_calls.
 void add_collision_handler(const cpCollisionHandler &handler) noexcept;
 
 struct collision_handler_wildcard_options_t
@@ -93,14 +276,30 @@ struct collision_handler_wildcard_options_t
 void add_collision_handler_wildcard(
     const collision_handler_wildcard_options_t &options) noexcept;
 
-/// Create a physics body and return a handle to it.
+/// Create a physics body and return a handle to it. If called from inside a
+/// collision callback, the handle is usable immediately but the body will not
+/// be added to the space until the end of the step. The same goes for all the
+/// create_*_shape functions.
 raw_body_t create_body(game_id_e id,
                        const lib::body_t::body_options_t &options) noexcept;
 
+struct segment_chain_options_t
+{
+    cpCollisionType collision_type;
+    float radius;
+    /// Whether to also connect the last vertex back to the first one
+    bool closed;
+};
+
 // clang-format off
 /// Create a segment (line) shape attached to a body
 raw_segment_shape_t create_segment_shape(const raw_body_t &body_handle, const lib::segment_shape_t::options_t &options) noexcept;
 
+/// Create a segment shape for each pair of consecutive vertices, with
+/// neighbors set so that things sliding along the chain don't catch on the
+/// joints. Appends the new handles to out.
+void create_segment_chain(const raw_body_t &body_handle, lib::slice_t<const lib::vect_t> vertices, const segment_chain_options_t &options, std::vector<raw_segment_shape_t> &out) noexcept;
+
 /// Create a box shape attached to a body (shortcut for poly shape)
 raw_poly_shape_t create_box_shape(const raw_body_t &body_handle, const lib::poly_shape_t::square_options_t &options) noexcept;
 
@@ -109,14 +308,14 @@ raw_poly_shape_t create_polygon_shape(const raw_body_t &body_handle, const lib::
 // clang-format on
 
 /// Alternative to set_physics_id which is slower but lets you also pass in a
-/// pointer to something.
-/// TODO: make this free existing user data and id. right now assigning multiple
-/// times causes a memory leak.
+/// pointer to something. Frees any user data set previously.
 void set_user_data_and_id(raw_body_t handle, game_id_e id, void *data) noexcept;
 void set_user_data_and_id(raw_poly_shape_t handle, game_id_e id,
                           void *data) noexcept;
 void set_user_data_and_id(raw_segment_shape_t handle, game_id_e id,
                           void *data) noexcept;
+/// Free the user data of a body, if it has any, keeping only its id
+void clear_user_data(raw_body_t handle) noexcept;
 /// returns the ID of the object, unless it was not set with set_physics_id() or
 /// physics::set_user_data_and_id().
 lib::opt_t<game_id_e> get_id(raw_body_t handle) noexcept;
@@ -133,13 +332,145 @@ lib::opt_t<void *> get_user_data(raw_segment_shape_t handle) noexcept;
 lib::opt_t<void *> get_user_data(const lib::shape_t &shape) noexcept;
 
 /// Delete a segment shape. Also deletes any user data that may be attached.
+/// If called from inside a collision callback, the deletion is deferred until
+/// the end of the step and the handle stays valid until then.
 void delete_segment_shape(raw_segment_shape_t) noexcept;
 /// Delete a polygon shape. Also deletes any user data that may be attached.
+/// Deferred if called from inside a collision callback.
 void delete_polygon_shape(raw_poly_shape_t) noexcept;
 /// Delete a physics body. Also deletes any user data that may be attached.
+/// Deferred if called from inside a collision callback.
 void delete_body(raw_body_t) noexcept;
 
-void debug_draw_all_shapes() noexcept;
+/// Delete every body and shape with the given game id. They are found in one
+/// pass over the pools and then removed together, shapes before bodies, with
+/// the same sorted flush used for deferred deletions. Shapes inherit their
+/// body's id when they are created, so a body and its shapes are normally
+/// removed together. The global static body is never deleted. Returns the
+/// number of objects deleted. Like the other delete functions, this is
+/// deferred if called from inside a collision callback or a batch.
+size_t delete_all_with_id(game_id_e id) noexcept;
+/// A set of game ids, with bit n set for the id whose value is n
+using game_id_set_t = std::bitset<256>;
+/// Same as delete_all_with_id(), but for every id in the set at once, still
+/// with one pass over the pools
+size_t delete_all_with_ids(const game_id_set_t &ids) noexcept;
+/// Delete every shape with the given collision type, the same way as
+/// delete_all_with_id(). Bodies are left alone. Returns the number of shapes
+/// deleted.
+size_t delete_all_with_collision_type(collision_type_e type) noexcept;
+
+/// Between these two calls, create_* and delete_* functions queue their
+/// changes to the space like they do inside a collision callback, and
+/// end_batch() applies all of them at once: every addition to the space, then
+/// every removal, then every pool free. Handles stay valid until then, and
+/// newly created objects can be positioned before they enter the spatial index.
+/// Calls can be nested, only the outermost end applies the changes.
+void begin_batch() noexcept;
+void end_batch() noexcept;
+
+/// Make sure that the given number of bodies and shapes (and the user data for
+/// each of them) can be created without growing any pools
+void reserve(size_t bodies, size_t poly_shapes,
+             size_t segment_shapes = 0) noexcept;
+
+/// Take a dynamic body out of the simulation without removing it from the
+/// space, so that it can be reused later without paying for the removal and
+/// reinsertion. Its shapes get CP_SHAPE_FILTER_NONE, so they stop colliding
+/// and stop showing up in queries, and the body is stopped. Its velocity and
+/// position update functions are replaced with ones that do nothing except
+/// keep it awake, since sleeping would move its shapes from the dynamic
+/// spatial index into the static one. update_activation() leaves it alone,
+/// and it is left out of dynamic_bodies() and debug_draw_all_shapes().
+///
+/// A disabled body still costs something every step: chipmunk calls both of
+/// its (nearly empty) update functions, and its shapes stay in the dynamic
+/// index, where they are revisited but never move. A body which was already asleep when it
+/// was disabled stays asleep until enable() moves it.
+void disable(raw_body_t handle) noexcept;
+/// Undo disable(): move the body, give it a velocity, wake it up, and give its
+/// shapes CP_SHAPE_FILTER_ALL (the filter every shape is created with) again.
+void enable(raw_body_t handle, lib::vect_t position,
+            lib::vect_t velocity) noexcept;
+[[nodiscard]] bool is_disabled(raw_body_t handle) noexcept;
+
+/// Draw the outline of every polygon and segment shape as lines, in one rlgl
+/// batch. Lines for shapes on static bodies are cached between frames. Dynamic
+/// bodies are drawn alpha of the way between their position before the last
+/// step and their current position.
+void debug_draw_all_shapes(float alpha = 1.0f) noexcept;
+
+/// Bitmask of collision types that a spatial query should report. Build one
+/// with query_filter(), or use query_filter_all.
+using query_filter_t = uint32_t;
+inline constexpr query_filter_t query_filter_all = ~query_filter_t(0);
+static_assert(size_t(collision_type_e::MAX) <= sizeof(query_filter_t) * 8,
+              "Too many collision types to fit in query_filter_t");
+
+/// Make a filter which only accepts shapes of the given collision types
+inline constexpr query_filter_t
+query_filter(std::initializer_list<collision_type_e> types) noexcept
+{
+    query_filter_t filter = 0;
+    for (auto type : types) {
+        filter |= query_filter_t(1) << query_filter_t(type);
+    }
+    return filter;
+}
+
+/// A shape found by one of the query_* functions.
+struct query_hit_t
+{
+    lib::shape_t *shape;
+    /// game id of the shape, or game_id_e::NULLP if it has none
+    game_id_e id;
+    cpCollisionType collision_type;
+    /// For segment queries, the point of impact. For point queries, the
+    /// closest point on the shape. For shape queries, the first contact point.
+    lib::vect_t point;
+    /// For segment queries, the surface normal at the point of impact. For
+    /// point queries, the gradient of the distance function. For shape
+    /// queries, the contact normal. Zero for bounding box queries.
+    lib::vect_t normal;
+    /// For segment queries, the fraction along the segment where the hit
+    /// occurred (0 to 1). For point queries, the distance to the point
+    /// (negative if the point is inside the shape). Zero otherwise.
+    float distance;
+};
+
+// All of the query functions write into a buffer provided by the caller and
+// return the part of it that was filled. If there are more hits than the buffer
+// can hold, the extra hits are dropped. They never allocate.
+
+/// Find all shapes which a (optionally thick) line from start to end passes
+/// through. Hits are not sorted.
+lib::slice_t<query_hit_t> query_segment(lib::vect_t start, lib::vect_t end,
+                                        float radius, query_filter_t filter,
+                                        lib::slice_t<query_hit_t> out) noexcept;
+
+/// Find the first shape that a line from start to end hits, if any.
+lib::opt_t<query_hit_t> query_segment_first(lib::vect_t start, lib::vect_t end,
+                                            float radius,
+                                            query_filter_t filter) noexcept;
+
+/// Find the shape closest to point, within max_distance.
+lib::opt_t<query_hit_t> query_point_nearest(lib::vect_t point,
+                                            float max_distance,
+                                            query_filter_t filter) noexcept;
+
+/// Find all shapes whose bounding boxes overlap the given box. The box is
+/// interpreted the same way as poly_shape_t::square_options_t::bounding.
+lib::slice_t<query_hit_t> query_bb(const lib::rect_t &box,
+                                   query_filter_t filter,
+                                   lib::slice_t<query_hit_t> out) noexcept;
+
+/// Find all shapes which overlap the given shape (not including itself).
+lib::slice_t<query_hit_t> query_shape(raw_poly_shape_t shape,
+                                      query_filter_t filter,
+                                      lib::slice_t<query_hit_t> out) noexcept;
+lib::slice_t<query_hit_t> query_shape(raw_segment_shape_t shape,
+                                      query_filter_t filter,
+                                      lib::slice_t<query_hit_t> out) noexcept;
 
 /// Return a handle for an existing body. useful if you got the body from a
 /// collision handler and need to be able to address it with physics functions
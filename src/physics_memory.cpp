@@ -0,0 +1,235 @@
+#include "physics_memory.hpp"
+#include "natural_log/natural_log.hpp"
+#include "root_allocator.hpp"
+#include "world.hpp"
+#include <array>
+#include <cstdint>
+#include <cstring>
+
+/// Smallest block handed out is 1 << min_class_shift bytes
+constexpr size_t min_class_shift = 5;
+/// Number of power of two size classes. Anything bigger than the biggest one is
+/// allocated and freed directly.
+constexpr size_t num_size_classes = 12;
+constexpr uint8_t large_block = 0xFF;
+
+constexpr auto allocation_type = allo::interfaces::AllocationType::Physics;
+
+/// Stored immediately before every block given to chipmunk
+struct alignas(std::max_align_t) block_header_t
+{
+    /// Links in either the live list or a free list
+    block_header_t *prev;
+    block_header_t *next;
+    /// Usable bytes after the header
+    size_t capacity;
+    /// Bytes that chipmunk actually asked for
+    size_t requested;
+    uint8_t size_class;
+};
+
+namespace cw::physics::memory {
+/// Blocks belong to the world whose space allocated them, so that separate
+/// worlds can be stepped on separate threads without sharing free lists
+struct world_state_t
+{
+    block_header_t *live_blocks = nullptr;
+    std::array<block_header_t *, num_size_classes> free_lists{};
+    stats_t memory_stats{};
+};
+} // namespace cw::physics::memory
+
+static cw::physics::memory::world_state_t &state() noexcept
+{
+    return cw::expect_world_state(cw::current_world().physics_memory,
+                                  "physics memory");
+}
+
+static uint8_t size_class_for(size_t bytes) noexcept
+{
+    for (uint8_t size_class = 0; size_class < num_size_classes; ++size_class) {
+        if (bytes <= size_t(1) << (size_class + min_class_shift))
+            return size_class;
+    }
+    return large_block;
+}
+
+static size_t capacity_for(uint8_t size_class, size_t bytes) noexcept
+{
+    return size_class == large_block
+               ? bytes
+               : size_t(1) << (size_class + min_class_shift);
+}
+
+static void push(block_header_t *&list, block_header_t *block) noexcept
+{
+    block->prev = nullptr;
+    block->next = list;
+    if (list)
+        list->prev = block;
+    list = block;
+}
+
+static void unlink(block_header_t *&list, block_header_t *block) noexcept
+{
+    if (block->prev)
+        block->prev->next = block->next;
+    else
+        list = block->next;
+    if (block->next)
+        block->next->prev = block->prev;
+}
+
+static void free_block(block_header_t *block) noexcept
+{
+    auto status = cw::root_allocator.free(
+        allocation_type, block, sizeof(block_header_t) + block->capacity);
+    if (!status.okay()) [[unlikely]] {
+        LN_WARN_FMT("Failed to free chipmunk memory block with errcode {}",
+                    fmt::underlying(status.status()));
+    }
+}
+
+/// Get an uninitialized block of at least the given size and put it on the live
+/// list
+static block_header_t *acquire(size_t bytes) noexcept
+{
+    auto &memory = state();
+    auto &stats = memory.memory_stats;
+    ++stats.allocations;
+    const uint8_t size_class = size_class_for(bytes);
+    const size_t capacity = capacity_for(size_class, bytes);
+
+    block_header_t *block = nullptr;
+    if (size_class != large_block &&
+        memory.free_lists[size_class] != nullptr) {
+        block = memory.free_lists[size_class];
+        unlink(memory.free_lists[size_class], block);
+        stats.cached_bytes -= capacity;
+        ++stats.reused;
+    } else {
+        auto res = cw::root_allocator.alloc(allocation_type, 1,
+                                            sizeof(block_header_t) + capacity);
+        if (!res.okay()) [[unlikely]] {
+            LN_ERROR_FMT("Failed to allocate {} bytes for chipmunk", bytes);
+            return nullptr;
+        }
+        block = reinterpret_cast<block_header_t *>(res.release().data());
+        block->capacity = capacity;
+        block->size_class = size_class;
+    }
+
+    block->requested = bytes;
+    push(memory.live_blocks, block);
+    ++stats.live_blocks;
+    stats.live_bytes += bytes;
+    return block;
+}
+
+/// Take a block off the live list and either cache it or give it back
+static void retire(block_header_t *block) noexcept
+{
+    auto &memory = state();
+    auto &stats = memory.memory_stats;
+    unlink(memory.live_blocks, block);
+    --stats.live_blocks;
+    stats.live_bytes -= block->requested;
+
+    if (block->size_class == large_block) {
+        free_block(block);
+        return;
+    }
+    push(memory.free_lists[block->size_class], block);
+    stats.cached_bytes += block->capacity;
+}
+
+static void *data_of(block_header_t *block) noexcept { return block + 1; }
+
+static block_header_t *header_of(void *data) noexcept
+{
+    return static_cast<block_header_t *>(data) - 1;
+}
+
+namespace cw::physics::memory {
+
+void init() noexcept
+{
+    current_world().physics_memory = create_world_state<world_state_t>();
+}
+
+void cleanup() noexcept
+{
+    if (!current_world().physics_memory) [[unlikely]]
+        return;
+    release_all();
+    destroy_world_state(current_world().physics_memory);
+}
+
+const stats_t &stats() noexcept { return state().memory_stats; }
+
+void release_all() noexcept
+{
+    auto &[live_blocks, free_lists, memory_stats] = state();
+    if (live_blocks != nullptr) {
+        LN_INFO_FMT("Releasing {} chipmunk allocations ({} bytes) that were "
+                    "never freed",
+                    memory_stats.live_blocks, memory_stats.live_bytes);
+    }
+
+    auto release_list = [](block_header_t *&list) {
+        while (list != nullptr) {
+            block_header_t *next = list->next;
+            free_block(list);
+            list = next;
+        }
+    };
+
+    release_list(live_blocks);
+    for (auto &list : free_lists) {
+        release_list(list);
+    }
+    memory_stats = {};
+}
+
+} // namespace cw::physics::memory
+
+extern "C" {
+void *cw_physics_calloc(size_t count, size_t size)
+{
+    const size_t bytes = count * size;
+    block_header_t *block = acquire(bytes);
+    if (!block) [[unlikely]]
+        return nullptr;
+    std::memset(data_of(block), 0, bytes);
+    return data_of(block);
+}
+
+void *cw_physics_realloc(void *data, size_t size)
+{
+    if (!data)
+        return cw_physics_calloc(1, size);
+
+    block_header_t *old_block = header_of(data);
+    if (size <= old_block->capacity) {
+        auto &stats = state().memory_stats;
+        stats.live_bytes += size;
+        stats.live_bytes -= old_block->requested;
+        old_block->requested = size;
+        return data;
+    }
+
+    block_header_t *new_block = acquire(size);
+    if (!new_block) [[unlikely]]
+        return nullptr;
+    std::memcpy(data_of(new_block), data, old_block->requested);
+    retire(old_block);
+    return data_of(new_block);
+}
+
+void cw_physics_free(void *data)
+{
+    if (!data)
+        return;
+    retire(header_of(data));
+}
+}
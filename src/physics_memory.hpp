@@ -0,0 +1,50 @@
+#pragma once
+/// Memory used internally by chipmunk (arbiters, contact buffers, spatial index
+/// nodes, etc). The chipmunk dependency is built with cpcalloc, cprealloc, and
+/// cpfree defined to the cw_physics_* functions below, so that all of its
+/// allocations come from here instead of straight from libc.
+///
+/// Blocks are rounded up to a power of two and kept on a free list when
+/// chipmunk frees them, so the narrowphase stops hitting malloc once the space
+/// has warmed up. Everything is allocated from the root allocator as
+/// AllocationType::Physics. Each world has its own blocks and free lists, and
+/// the hooks use the calling thread's current world.
+
+#include <cstddef>
+
+namespace cw::physics::memory {
+
+struct stats_t
+{
+    /// Number of blocks chipmunk currently has allocated
+    size_t live_blocks;
+    /// Bytes chipmunk asked for and currently has allocated
+    size_t live_bytes;
+    /// Bytes sitting in the free lists, waiting to be reused
+    size_t cached_bytes;
+    /// Total number of times chipmunk has allocated or reallocated
+    size_t allocations;
+    /// How many of those were served from the free lists
+    size_t reused;
+};
+
+/// Create the current world's allocator state. Must be called before the
+/// world's space is created.
+void init() noexcept;
+
+/// release_all() and then destroy the current world's allocator state
+void cleanup() noexcept;
+
+[[nodiscard]] const stats_t &stats() noexcept;
+
+/// Return all memory to the root allocator, including blocks that chipmunk
+/// never freed. Only call this after the space has been destroyed.
+void release_all() noexcept;
+
+} // namespace cw::physics::memory
+
+extern "C" {
+void *cw_physics_calloc(size_t count, size_t size);
+void *cw_physics_realloc(void *block, size_t size);
+void cw_physics_free(void *block);
+}
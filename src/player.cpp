@@ -1,11 +1,13 @@
 #include "player.hpp"
 #include "build_site.hpp"
+#include "constants/physics.hpp"
 #include "game_ids.hpp"
 #include "globals.hpp"
 #include "physics.hpp"
 #include "thelib/rect.hpp"
 #include "thelib/shape.hpp"
 #include "physics_collision_types.hpp"
+#include <cmath>
 #include <memory>
 #include <raylib.h>
 
@@ -53,6 +55,12 @@ void player_t::draw()
     // DrawRectangle(pos.x, pos.y, bounding_box_size, bounding_box_size, RED);
 }
 
+lib::rect_t player_t::hitbox() const noexcept
+{
+    return lib::rect_t(physics::get_body(body).position(),
+                       lib::vect_t(bounding_box_size));
+}
+
 void player_t::update()
 {
     lib::vect_t velocity(0);
@@ -92,12 +100,23 @@ void player_t::update()
     if (IsKeyPressed(KEY_SPACE) && holding_wire) {
         wire.spawn_tool(lib::vect_t(pos.x, pos.y));
     }
+}
+
+void player_t::update_camera(float dt, float alpha) noexcept
+{
+    // follow where the player is drawn rather than where the last step left
+    // it, so interpolated things don't jitter against the camera
+    const lib::vect_t pos = physics::interpolated_position(body, alpha);
+
+    // the same as covering 1/cam_followspeed of the distance every physics
+    // step, but independent of the frame rate
+    const float steps = dt / PHYSICS_TIME_STEP;
+    const float follow = 1.0f - std::pow(1.0f - (1.0f / cam_followspeed), steps);
+
     // Lerp the camera to the players position
     Camera2D &camera_player = cw::get_main_camera();
-    camera_player.target.x +=
-        (pos.x - camera_player.target.x) / cam_followspeed;
-    camera_player.target.y +=
-        (pos.y - camera_player.target.y) / cam_followspeed;
+    camera_player.target.x += (pos.x - camera_player.target.x) * follow;
+    camera_player.target.y += (pos.y - camera_player.target.y) * follow;
 }
 
 void player_t::collision_handler_static(cpArbiter *arb, cpSpace *space, cpDataPointer userData) {
@@ -11,6 +11,13 @@ struct player_t {
     public:
         void draw();
         void update();
+        /// Move the camera towards the player's interpolated position. Call
+        /// once per frame after stepping physics, with the frame time and the
+        /// interpolation alpha used for drawing.
+        void update_camera(float dt, float alpha) noexcept;
+        /// The player's box shape bounds in world space, centered on the
+        /// rect's position like lib::rect_t's conversion to cpBB
+        [[nodiscard]] lib::rect_t hitbox() const noexcept;
         static void collision_handler_static(cpArbiter *arb, cpSpace *space, cpDataPointer userData);
 
         player_t() noexcept;
@@ -2,6 +2,8 @@
 #include "constants/screen.hpp"
 #include "globals.hpp"
 #include "thelib/rect.hpp"
+#include <algorithm>
+#include <array>
 #include <raylib.h>
 
 // window scaling and splitscreen
@@ -37,6 +39,27 @@ void init() noexcept
     main_target = LoadRenderTexture(GAME_WIDTH, GAME_HEIGHT);
     SetTextureFilter(main_target.texture, TEXTURE_FILTER_POINT);
 }
+
+cpBB visible_area() noexcept
+{
+    const Camera2D &cam = get_main_camera();
+    // the camera draws into main_target, so its corners are the screen
+    const std::array<Vector2, 4> corners{
+        GetScreenToWorld2D({0, 0}, cam),
+        GetScreenToWorld2D({float(GAME_WIDTH), 0}, cam),
+        GetScreenToWorld2D({0, float(GAME_HEIGHT)}, cam),
+        GetScreenToWorld2D({float(GAME_WIDTH), float(GAME_HEIGHT)}, cam),
+    };
+    // the camera may be rotated, so take the box around all four corners
+    cpBB area{corners[0].x, corners[0].y, corners[0].x, corners[0].y};
+    for (const Vector2 &corner : corners) {
+        area.l = std::min(area.l, cpFloat(corner.x));
+        area.b = std::min(area.b, cpFloat(corner.y));
+        area.r = std::max(area.r, cpFloat(corner.x));
+        area.t = std::max(area.t, cpFloat(corner.y));
+    }
+    return area;
+}
 } // namespace cw::render_pipeline
 
 /// Resize the game's main render texture and draw it to the window.
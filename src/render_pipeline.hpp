@@ -1,4 +1,5 @@
 #pragma once
+#include "chipmunk/cpBB.h"
 #include <raylib.h>
 
 namespace cw::render_pipeline {
@@ -8,4 +9,8 @@ void render(void (*game_draw)(), void (*hud_draw)()) noexcept;
 /// Initialize and configure render pipeline by setting values in the
 /// RenderTexture
 void init() noexcept;
+
+/// The part of the world that the main camera shows, in world coordinates. For
+/// culling things before drawing them.
+[[nodiscard]] cpBB visible_area() noexcept;
 } // namespace cw::render_pipeline
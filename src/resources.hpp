@@ -19,6 +19,7 @@ enum class image_id_e : uint8_t
     Prop_Sheet_01,
     Prop_Sheet_02,
     Prop_Tin_Box,
+    Projectile_Bullet,
     IMAGE_ID_MAX,
 };
 
@@ -29,6 +30,7 @@ struct _image_association_t
 };
 
 #define PROPDIR "assets/prop/"
+#define PROJECTILEDIR "assets/projectile/"
 
 constexpr std::array image_id_associations{
     _image_association_t{
@@ -71,9 +73,14 @@ constexpr std::array image_id_associations{
         .id = image_id_e::Prop_Tin_Box,
         .path = PROPDIR "tin_box.png",
     },
+    _image_association_t{
+        .id = image_id_e::Projectile_Bullet,
+        .path = PROJECTILEDIR "bullet.png",
+    },
 };
 
 #undef PROPDIR
+#undef PROJECTILEDIR
 
 /// Load all resources into memory
 void load();
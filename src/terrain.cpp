@@ -2,6 +2,7 @@
 #include "physics.hpp"
 #include "physics_collision_types.hpp"
 #include "thelib/opt.hpp"
+#include "world.hpp"
 #include <array>
 #include <vector>
 
@@ -9,11 +10,18 @@
 constexpr size_t initial_reservation = 256;
 constexpr float smoothing_radius = 2.0f;
 
-static lib::opt_t<std::array<std::vector<cw::physics::raw_segment_shape_t>,
-                             cw::num_terrain_ids>>
-    shapes_by_id;
-
 namespace cw::terrain {
+struct world_state_t
+{
+    std::array<std::vector<physics::raw_segment_shape_t>, num_terrain_ids>
+        shapes_by_id;
+};
+
+static world_state_t &state() noexcept
+{
+    return expect_world_state(current_world().terrain, "terrain");
+}
+
 void init()
 {
     constexpr auto static_body_options = lib::body_t::body_options_t{
@@ -23,8 +31,8 @@ void init()
     };
 
     // reserve some
-    shapes_by_id.emplace();
-    for (std::vector<physics::raw_segment_shape_t> vec : shapes_by_id.value()) {
+    current_world().terrain = create_world_state<world_state_t>();
+    for (auto &vec : state().shapes_by_id) {
         vec.reserve(initial_reservation);
     }
 }
@@ -32,7 +40,7 @@ void init()
 void load_polygon(const game_id_e terrain_id,
                   lib::slice_t<const lib::vect_t> &vertices)
 {
-    if (!shapes_by_id.has_value()) {
+    if (!current_world().terrain) {
         LN_ERROR("Attempt to create a terrain polygon, but the terrain module "
                  "has not been initialized.");
         return;
@@ -44,7 +52,7 @@ void load_polygon(const game_id_e terrain_id,
         return;
     }
 
-    cpCollisionType collision_type;
+    cpCollisionType collision_type = 0;
     // convert game id to collision type
     switch (terrain_id) {
     case game_id_e::Terrain_Ditch:
@@ -63,69 +71,49 @@ void load_polygon(const game_id_e terrain_id,
     const uint8_t index =
         uint8_t(terrain_id) - uint8_t(game_id_e::INVALID_SECT_2_BEGIN) - 1;
 
-    auto mksegment = [index,
-                      terrain_id](lib::segment_shape_t::options_t options) {
-        auto shape =
-            physics::create_segment_shape(physics::get_static_body(), options);
-        shapes_by_id.value()[index].push_back(shape);
-        auto &actual = physics::get_segment_shape(shape);
-        set_physics_id(*actual.parent_cast(), terrain_id);
-    };
+    auto &shapes = state().shapes_by_id[index];
+    const size_t first_new = shapes.size();
+    physics::create_segment_chain(physics::get_static_body(), vertices,
+                                  {
+                                      .collision_type = collision_type,
+                                      .radius = smoothing_radius,
+                                      .closed = true,
+                                  },
+                                  shapes);
 
-    if (vertices.size() == 2) {
-        mksegment({
-            .collision_type = collision_type,
-            .a = vertices.data()[0],
-            .b = vertices.data()[1],
-            .radius = smoothing_radius,
-        });
-        return;
+    for (size_t i = first_new; i < shapes.size(); ++i) {
+        set_physics_id(*physics::get_segment_shape(shapes[i]).parent_cast(),
+                       terrain_id);
     }
-
-    size_t i = 0;
-    for (const auto &vect : vertices) {
-        if (i + 1 == vertices.size()) {
-            break;
-        }
-        lib::segment_shape_t::options_t options{
-            .collision_type = collision_type,
-            .a = vect,
-            .b = vertices.data()[i + 1],
-            .radius = smoothing_radius,
-        };
-        mksegment(options);
-        ++i;
-    }
-
-    mksegment({
-        .a = vertices.data()[vertices.size() - 1],
-        .b = vertices.data()[0],
-    });
 }
 
 void clear_level()
 {
-    if (!shapes_by_id.has_value()) {
+    if (!current_world().terrain) {
         LN_WARN("Attempt to clear_level() but the terrain modules does not "
                 "seem to be initialized");
         return;
     }
 
-    for (const auto &vec : shapes_by_id.value()) {
-        for (const auto &shape : vec) {
-            physics::delete_segment_shape(shape);
-        }
+    // all terrain shapes have their terrain id set, so they can all be found
+    // and removed in one pass instead of looking up every handle
+    auto &shapes_by_id = state().shapes_by_id;
+    physics::game_id_set_t ids;
+    for (size_t i = 0; i < shapes_by_id.size(); ++i) {
+        ids.set(size_t(game_id_e::INVALID_SECT_2_BEGIN) + 1 + i);
+        shapes_by_id[i].clear();
     }
+    physics::delete_all_with_ids(ids);
 }
 
 void cleanup()
 {
-    if (!shapes_by_id.has_value()) {
+    if (!current_world().terrain) {
         LN_WARN("Attempt to cleanup() terrain but it does not seem to be "
                 "initialized");
         return;
     }
     clear_level();
-    shapes_by_id.reset();
+    destroy_world_state(current_world().terrain);
 }
 } // namespace cw::terrain
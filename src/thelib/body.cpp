@@ -65,6 +65,15 @@ void body_t::apply_impulse_at_world_point(const force_options_t &options)
     cpBodyApplyImpulseAtWorldPoint(this, options.force, options.point);
 }
 
+bool body_t::is_sleeping() const TESTING_NOEXCEPT
+{
+    return cpBodyIsSleeping(this);
+}
+
+void body_t::sleep() TESTING_NOEXCEPT { cpBodySleep(this); }
+
+void body_t::activate() TESTING_NOEXCEPT { cpBodyActivate(this); }
+
 void body_t::free() TESTING_NOEXCEPT
 {
     remove_from_space();
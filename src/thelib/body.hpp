@@ -86,6 +86,13 @@ class body_t : public ::cpBody
 
     void free() TESTING_NOEXCEPT;
 
+    /// Sleeping bodies are skipped by the simulation until something touches
+    /// them or they are activated. Only dynamic bodies in a space with
+    /// sleeping enabled can be put to sleep.
+    [[nodiscard]] bool is_sleeping() const TESTING_NOEXCEPT;
+    void sleep() TESTING_NOEXCEPT;
+    void activate() TESTING_NOEXCEPT;
+
     // read-only
     [[nodiscard]] Type type() TESTING_NOEXCEPT;
 
@@ -73,11 +73,16 @@ void space_t::set_iterations(int iterations) TESTING_NOEXCEPT
     cpSpaceSetIterations(this, iterations);
 }
 
-// read only
 float space_t::get_sleep_time_threshold() const TESTING_NOEXCEPT
 {
     return cpSpaceGetSleepTimeThreshold(this);
 }
+void space_t::set_sleep_time_threshold(float threshold) TESTING_NOEXCEPT
+{
+    cpSpaceSetSleepTimeThreshold(this, threshold);
+}
+
+// read only
 body_t *space_t::get_static_body() const TESTING_NOEXCEPT
 {
     return static_cast<body_t *>(cpSpaceGetStaticBody(this));
@@ -86,6 +91,10 @@ float space_t::get_current_time_step() const TESTING_NOEXCEPT
 {
     return cpSpaceGetCurrentTimeStep(this);
 }
+bool space_t::is_locked() const TESTING_NOEXCEPT
+{
+    return cpSpaceIsLocked(const_cast<space_t *>(this));
+}
 
 void space_t::step(float timestep) TESTING_NOEXCEPT { cpSpaceStep(this, timestep); }
 } // namespace lib
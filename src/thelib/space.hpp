@@ -97,7 +97,13 @@ class space_t : public ::cpSpace
     [[nodiscard]] int iterations() const TESTING_NOEXCEPT;
 
     [[nodiscard]] float get_sleep_time_threshold() const TESTING_NOEXCEPT;
+    /// How long a body has to be idle before chipmunk puts it to sleep.
+    /// INFINITY (the default) disables sleeping entirely.
+    void set_sleep_time_threshold(float threshold) TESTING_NOEXCEPT;
     [[nodiscard]] body_t *get_static_body() const TESTING_NOEXCEPT;
     [[nodiscard]] float get_current_time_step() const TESTING_NOEXCEPT;
+    /// Whether the space is in the middle of a step or query, meaning that
+    /// bodies and shapes cannot be added or removed.
+    [[nodiscard]] bool is_locked() const TESTING_NOEXCEPT;
 };
 } // namespace lib
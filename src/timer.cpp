@@ -0,0 +1,161 @@
+#include "timer.hpp"
+#include "natural_log/natural_log.hpp"
+#include "thelib/opt.hpp"
+#include "world.hpp"
+#include <array>
+#include <cmath>
+#include <vector>
+
+/// Each wheel has 1 << slot_bits slots
+constexpr size_t slot_bits = 6;
+constexpr size_t slots_per_wheel = size_t(1) << slot_bits;
+constexpr uint64_t slot_mask = slots_per_wheel - 1;
+/// With four wheels, timers up to 2^24 ticks (about 77 hours) away are placed
+/// exactly. Ones further away than that go into the last slot of the coarsest
+/// wheel and get placed again once it comes up.
+constexpr size_t wheel_count = 4;
+constexpr size_t initial_timer_reservation = 64;
+
+using slot_t = std::vector<cw::timer::raw_timer_t>;
+
+namespace cw::timer {
+struct world_state_t
+{
+    lib::opt_t<timer_allocator> timers;
+    /// Slots hold handles which may be stale, cancelling a timer only frees it
+    /// from the pool and the handle is skipped when its slot comes up
+    std::array<std::array<slot_t, slots_per_wheel>, wheel_count> wheels;
+    uint64_t now = 0;
+    /// Scratch space for update(), swapped with the slot being processed so
+    /// that callbacks can start timers which land in that same slot
+    slot_t due;
+};
+} // namespace cw::timer
+
+static cw::timer::world_state_t &state() noexcept
+{
+    return cw::expect_world_state(cw::current_world().timer, "timer");
+}
+
+/// Put a timer into the slot for its deadline, on the finest wheel that
+/// reaches that far
+static void insert(cw::timer::raw_timer_t handle, uint64_t deadline) noexcept
+{
+    auto &timers = state();
+    const uint64_t delta = deadline - timers.now;
+    for (size_t wheel = 0; wheel < wheel_count; ++wheel) {
+        const size_t shift = wheel * slot_bits;
+        if (delta >> (shift + slot_bits) == 0) {
+            timers.wheels[wheel][(deadline >> shift) & slot_mask].push_back(
+                handle);
+            return;
+        }
+    }
+    // too far away, park it in the slot of the coarsest wheel which comes up
+    // last and try again from there
+    constexpr size_t shift = (wheel_count - 1) * slot_bits;
+    timers.wheels[wheel_count - 1][((timers.now >> shift) - 1) & slot_mask]
+        .push_back(handle);
+}
+
+/// Move every timer in a slot of a coarse wheel into the finer ones
+static void cascade(size_t wheel, size_t slot) noexcept
+{
+    auto &timers = state();
+    timers.due.clear();
+    std::swap(timers.due, timers.wheels[wheel][slot]);
+    auto &pool = timers.timers.value();
+    for (const auto &handle : timers.due) {
+        auto res = pool.get(handle);
+        if (!res.okay())
+            continue;
+        insert(handle, res.release().deadline);
+    }
+}
+
+namespace cw::timer {
+
+void init() noexcept
+{
+    current_world().timer = create_world_state<world_state_t>();
+    state().timers.emplace(initial_timer_reservation);
+}
+
+void cleanup() noexcept { destroy_world_state(current_world().timer); }
+
+uint32_t seconds_to_ticks(float seconds) noexcept
+{
+    const float ticks = std::ceil(seconds / tick_seconds);
+    if (!(ticks >= 1))
+        return 1;
+    if (ticks >= float(UINT32_MAX)) [[unlikely]]
+        return UINT32_MAX;
+    return uint32_t(ticks);
+}
+
+raw_timer_t start(const timer_options_t &options) noexcept
+{
+    if (!options.callback) [[unlikely]] {
+        LN_FATAL("Attempt to start a timer without a callback");
+        std::abort();
+    }
+
+    const uint64_t deadline = state().now + seconds_to_ticks(options.delay);
+    auto res = state().timers.value().alloc_new(timer_t{
+        .deadline = deadline,
+        .period_ticks =
+            options.period > 0 ? seconds_to_ticks(options.period) : 0,
+        .callback = options.callback,
+        .user_data = options.user_data,
+    });
+    if (!res.okay()) [[unlikely]] {
+        LN_FATAL("Got OOM when trying to start a timer");
+        std::abort();
+    }
+    const raw_timer_t handle = res.release();
+    insert(handle, deadline);
+    return handle;
+}
+
+bool try_cancel(raw_timer_t handle) noexcept
+{
+    return state().timers.value().free(handle).okay();
+}
+
+void update() noexcept
+{
+    auto &timers = state();
+    const uint64_t now = ++timers.now;
+
+    // coarse wheels first, so that a timer can cascade through several
+    // wheels on the same tick
+    for (size_t wheel = wheel_count - 1; wheel > 0; --wheel) {
+        const size_t shift = wheel * slot_bits;
+        if ((now & ((uint64_t(1) << shift) - 1)) == 0)
+            cascade(wheel, (now >> shift) & slot_mask);
+    }
+
+    timers.due.clear();
+    std::swap(timers.due, timers.wheels[0][now & slot_mask]);
+    auto &pool = timers.timers.value();
+    for (const raw_timer_t &handle : timers.due) {
+        auto res = pool.get(handle);
+        if (!res.okay())
+            continue;
+        timer_t &timer = res.release();
+        // copy out, since the callback may start timers and grow the pool
+        const callback_t callback = timer.callback;
+        void *const user_data = timer.user_data;
+        if (timer.period_ticks == 0) {
+            pool.free(handle);
+        } else {
+            timer.deadline = now + timer.period_ticks;
+            insert(handle, timer.deadline);
+        }
+        callback(user_data);
+    }
+}
+
+uint64_t now() noexcept { return state().now; }
+
+} // namespace cw::timer
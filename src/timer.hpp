@@ -0,0 +1,84 @@
+#pragma once
+
+#include "allo/pool_allocator_generational.hpp"
+#include "constants/physics.hpp"
+#include "root_allocator.hpp"
+#include <cstdint>
+
+namespace cw::timer {
+
+/// Initialize the timer wheel of the current world
+void init() noexcept;
+/// Drop every timer of the current world without calling it
+void cleanup() noexcept;
+
+/// Timers count in ticks of this many seconds, one per fixed physics step
+inline constexpr float tick_seconds = PHYSICS_TIME_STEP;
+
+/// Called when a timer goes off, with the user data it was started with
+using callback_t = void (*)(void *user_data) noexcept;
+
+struct timer_options_t
+{
+    /// Seconds until the first call. Rounded up to a whole number of ticks,
+    /// and always at least one tick.
+    float delay;
+    /// Seconds in between calls after the first one, rounded the same way as
+    /// delay. Zero makes a timer that only goes off once.
+    float period = 0;
+    callback_t callback;
+    void *user_data = nullptr;
+};
+
+/// Data stored per-timer
+struct timer_t
+{
+    /// Tick on which the timer goes off next
+    uint64_t deadline;
+    /// Zero for one shot timers
+    uint32_t period_ticks;
+    callback_t callback;
+    void *user_data;
+};
+
+/// The allocation behavior of the memory where timers are stored
+inline constexpr allo::pool_allocator_generational_options_t
+    timer_memory_options{
+        .allocator = root_allocator,
+        .allocation_type = allo::interfaces::AllocationType::Timers,
+        .reallocating = true,
+        .reallocation_ratio = 1.5f,
+    };
+
+using timer_allocator =
+    allo::pool_allocator_generational_t<timer_t, timer_memory_options,
+                                        uint32_t, uint32_t>;
+
+using raw_timer_t = timer_allocator::handle_t;
+
+/// Convert seconds to ticks, rounding up, with a minimum of one tick
+[[nodiscard]] uint32_t seconds_to_ticks(float seconds) noexcept;
+
+/// Start a timer. Safe to call from inside of a timer callback.
+raw_timer_t start(const timer_options_t &options) noexcept;
+
+/// Stop a timer so that it never goes off again. Returns false if the handle
+/// didn't point to anything, for example because it was a one shot timer
+/// which already went off. Safe to call from inside of a timer callback.
+bool try_cancel(raw_timer_t handle) noexcept;
+
+/// Advance time by one tick and call every timer which is due. Call once per
+/// fixed step.
+///
+/// Timers live in a hierarchical timing wheel: a wheel of 64 slots one tick
+/// apart, then one of 64 slots 64 ticks apart, and so on. A timer goes into
+/// the slot of its deadline on the finest wheel that reaches that far, and
+/// whenever a slot of a coarser wheel comes up its timers are moved into the
+/// finer wheels. Starting and cancelling are constant time, and each tick only
+/// looks at the timers which are due plus the ones being moved down.
+void update() noexcept;
+
+/// Number of times update() has been called in the current world
+[[nodiscard]] uint64_t now() noexcept;
+
+} // namespace cw::timer
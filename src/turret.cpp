@@ -1,55 +1,465 @@
 #include "turret.hpp"
 #include "allo/pool_allocator_generational.hpp"
+#include "bullet.hpp"
+#include "physics.hpp"
 #include "root_allocator.hpp"
 #include "thelib/opt.hpp"
+#include "timer.hpp"
+#include "turret_kernels.hpp"
+#include "turret_script.hpp"
+#include "world.hpp"
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstddef>
+#include <numbers>
+#include <vector>
 
-constexpr allo::pool_allocator_generational_options_t memopts = {
+constexpr size_t pattern_count = 3;
+constexpr size_t initial_turret_reservation = 10;
+
+using script_handle_t =
+    std::coroutine_handle<cw::turret::script_t::promise_type>;
+
+/// Memory for one script's coroutine frame
+struct alignas(std::max_align_t) script_frame_t
+{
+    std::byte bytes[cw::turret::script_frame_size];
+};
+
+constexpr allo::pool_allocator_generational_options_t script_frame_options{
     .allocator = cw::root_allocator,
     .allocation_type = allo::interfaces::AllocationType::Turret,
-    .reallocating = true,
-    .reallocation_ratio = 1.5f,
+    // a suspended script's frame must never move
+    .reallocating = false,
 };
 
-struct turret_t
+using script_frame_allocator =
+    allo::pool_allocator_generational_t<script_frame_t, script_frame_options,
+                                        uint32_t, uint32_t>;
+
+/// Every turret of one pattern, as structure-of-arrays so that each pattern's
+/// per-step work is one tight loop. Turrets are only ever removed all at once
+/// by clear_level(), so a turret's index in its batch never changes.
+struct turret_batch_t
 {
-    lib::vect_t position;
-    float fire_rate;
-    cw::turret::turret_pattern_e pattern;
+    std::vector<float> x;
+    std::vector<float> y;
+    /// Direction of the next shot, in radians
+    std::vector<float> angle;
+    /// Set by the fire timer, cleared once the shot is taken
+    std::vector<uint8_t> ready;
 };
 
-using turret_allocator = allo::pool_allocator_generational_t<turret_t, memopts>;
+/// Turrets controlled by scripts. Their scripts do all of the work, so nothing
+/// here is touched by update().
+struct scripted_batch_t
+{
+    std::vector<float> x;
+    std::vector<float> y;
+    std::vector<float> angle;
+    /// Null once the script has finished
+    std::vector<script_handle_t> scripts;
+};
 
-lib::opt_t<turret_allocator> allocator;
+/// Line of sight from each Tracking turret to the target, by index in the
+/// Tracking batch
+struct line_of_sight_cache_t
+{
+    std::vector<uint8_t> visible;
+    /// Where the target was when each turret was last tested. NaN if it never
+    /// was, so that any target position counts as having moved.
+    std::vector<float> tested_x;
+    std::vector<float> tested_y;
+    /// The turret to start testing from in the next update()
+    size_t cursor = 0;
+};
 
 namespace cw::turret {
 
-void update(float dt) noexcept
+struct world_state_t
+{
+    /// Indexed by turret_pattern_e
+    std::array<turret_batch_t, pattern_count> batches;
+    line_of_sight_cache_t line_of_sight;
+    scripted_batch_t scripted;
+    lib::opt_t<script_frame_allocator> script_frames;
+    /// Every fire timer that was started, so that they can be cancelled
+    std::vector<timer::raw_timer_t> fire_timers;
+    /// Shots of every batch and of the scripts that ran since the last
+    /// update(), spawned together at the end of it
+    std::vector<bullet::bullet_creation_options_t> shots;
+};
+
+static world_state_t &state() noexcept
+{
+    return expect_world_state(current_world().turret, "turret");
+}
+
+/// A turret's pattern and index packed into the user data of its fire timer
+static void *fire_timer_data(turret_pattern_e pattern, size_t index) noexcept
+{
+    return reinterpret_cast<void *>((uintptr_t(index) << 8) |
+                                    uintptr_t(pattern));
+}
+
+/// Fire timer callback
+static void mark_ready(void *user_data) noexcept
+{
+    const auto data = reinterpret_cast<uintptr_t>(user_data);
+    state().batches[data & 0xFF].ready[data >> 8] = 1;
+}
+
+/// Stop every fire timer, if the timers still exist
+static void cancel_fire_timers() noexcept
+{
+    auto &fire_timers = state().fire_timers;
+    if (current_world().timer) {
+        for (const timer::raw_timer_t &fire_timer : fire_timers) {
+            timer::try_cancel(fire_timer);
+        }
+    }
+    fire_timers.clear();
+}
+
+static bullet::bullet_creation_options_t shot(lib::vect_t position,
+                                              float angle) noexcept
+{
+    return bullet::bullet_creation_options_t{
+        .position = position,
+        .initial_velocity =
+            lib::vect_t(std::cos(angle), std::sin(angle)) * bullet_speed,
+    };
+}
+
+/// Queue a shot for every turret in the batch whose fire timer went off. If
+/// can_fire is not null, turrets for which it is zero skip their shot.
+static void take_shots(turret_batch_t &batch,
+                       std::vector<bullet::bullet_creation_options_t> &out,
+                       const uint8_t *can_fire) noexcept
 {
-    for (auto &turret : allocator.value()) {
+    const size_t count = batch.ready.size();
+    uint8_t *ready = batch.ready.data();
+    for (size_t i = 0; i < count; ++i) {
+        if (!ready[i]) [[likely]]
+            continue;
+        ready[i] = 0;
+        if (can_fire && !can_fire[i])
+            continue;
+        const lib::vect_t position(batch.x[i], batch.y[i]);
+        // turrets far from the player don't do anything, same as the physics
+        // bodies around them
+        if (!physics::is_in_active_region(position))
+            continue;
+        out.push_back(shot(position, batch.angle[i]));
     }
 }
 
+/// Forget every line of sight result, so they are all tested again
+static void invalidate_line_of_sight(line_of_sight_cache_t &cache) noexcept
+{
+    std::fill(cache.visible.begin(), cache.visible.end(), 0);
+    std::fill(cache.tested_x.begin(), cache.tested_x.end(), NAN);
+    std::fill(cache.tested_y.begin(), cache.tested_y.end(), NAN);
+}
+
+/// Look at up to line_of_sight_checks_per_tick Tracking turrets, going around
+/// the batch from the cursor, and test the line of sight of up to
+/// line_of_sight_queries_per_tick of them whose result is stale
+static void refresh_line_of_sight(const turret_batch_t &tracking,
+                                  line_of_sight_cache_t &cache,
+                                  lib::vect_t target) noexcept
+{
+    const size_t count = tracking.x.size();
+    if (count == 0)
+        return;
+    constexpr float threshold_sq =
+        line_of_sight_threshold * line_of_sight_threshold;
+
+    const size_t checks = std::min(count, line_of_sight_checks_per_tick);
+    size_t budget = line_of_sight_queries_per_tick;
+    size_t i = cache.cursor % count;
+    for (size_t checked = 0; checked < checks && budget > 0; ++checked) {
+        const float dx = target.x - cache.tested_x[i];
+        const float dy = target.y - cache.tested_y[i];
+        // written so that NaN (never tested) counts as stale
+        if (!((dx * dx) + (dy * dy) <= threshold_sq)) {
+            const lib::vect_t turret(tracking.x[i], tracking.y[i]);
+            cache.visible[i] = !physics::query_segment_first(
+                                    turret, target, 0, line_of_sight_filter)
+                                    .has_value();
+            cache.tested_x[i] = target.x;
+            cache.tested_y[i] = target.y;
+            --budget;
+        }
+        i = i + 1 == count ? 0 : i + 1;
+    }
+    cache.cursor = i;
+}
+
+void update(float dt, lib::opt_t<lib::vect_t> target) noexcept
+{
+    auto &batches = state().batches;
+    auto &line_of_sight = state().line_of_sight;
+    auto &shots = state().shots;
+
+    auto &tracking = batches[size_t(turret_pattern_e::Tracking)];
+    if (target.has_value()) {
+        if (!tracking.x.empty()) {
+            kernels::aim(tracking.x, tracking.y, target.value(),
+                         tracking.angle);
+        }
+        refresh_line_of_sight(tracking, line_of_sight, target.value());
+    } else {
+        invalidate_line_of_sight(line_of_sight);
+    }
+
+    // keep the angle within one turn either way so it doesn't lose precision
+    constexpr float two_pi = 2 * std::numbers::pi_v<float>;
+    auto &spiral = batches[size_t(turret_pattern_e::Spiral)];
+    const float turn = spiral_turn_rate * dt;
+    for (float &angle : spiral.angle) {
+        angle += turn;
+        angle -= two_pi * float(angle > two_pi);
+    }
+
+    // StraightLine turrets never turn, so they only have shots to take
+    for (size_t pattern = 0; pattern < pattern_count; ++pattern) {
+        const bool is_tracking = pattern == size_t(turret_pattern_e::Tracking);
+        take_shots(batches[pattern], shots,
+                   is_tracking ? line_of_sight.visible.data() : nullptr);
+    }
+    if (!shots.empty())
+        bullet::spawn_batch(shots, nullptr);
+    shots.clear();
+}
+
+/// Timer callback which ends a script's wait
+static void resume_script(void *address) noexcept
+{
+    auto script = script_handle_t::from_address(address);
+    script.promise().wake_timer.reset();
+    script.resume();
+}
+
+/// Destroy every script which hasn't finished, cancelling its wait if the
+/// timers still exist
+static void destroy_scripts() noexcept
+{
+    for (script_handle_t &script : state().scripted.scripts) {
+        if (!script)
+            continue;
+        auto &wake_timer = script.promise().wake_timer;
+        if (wake_timer.has_value() && current_world().timer)
+            timer::try_cancel(wake_timer.value());
+        // frees the frame, so the slot has to be cleared by hand
+        script.destroy();
+        script = {};
+    }
+}
+
+/// Drop every turret but keep the memory of the batches
+static void clear_batches() noexcept
+{
+    for (turret_batch_t &batch : state().batches) {
+        batch.x.clear();
+        batch.y.clear();
+        batch.angle.clear();
+        batch.ready.clear();
+    }
+    auto &line_of_sight = state().line_of_sight;
+    line_of_sight.visible.clear();
+    line_of_sight.tested_x.clear();
+    line_of_sight.tested_y.clear();
+    line_of_sight.cursor = 0;
+    auto &scripted = state().scripted;
+    scripted.x.clear();
+    scripted.y.clear();
+    scripted.angle.clear();
+    scripted.scripts.clear();
+}
+
 void init() noexcept
 {
-    // reserve space for 10 bullets
-    allocator.emplace(10);
+    current_world().turret = create_world_state<world_state_t>();
+    for (turret_batch_t &batch : state().batches) {
+        batch.x.reserve(initial_turret_reservation);
+        batch.y.reserve(initial_turret_reservation);
+        batch.angle.reserve(initial_turret_reservation);
+        batch.ready.reserve(initial_turret_reservation);
+    }
+}
+void cleanup() noexcept
+{
+    cancel_fire_timers();
+    destroy_scripts();
+    destroy_world_state(current_world().turret);
 }
-void cleanup() noexcept { allocator.reset(); }
 void clear_level() noexcept
 {
-    allocator.reset();
-    allocator.emplace(10);
+    cancel_fire_timers();
+    destroy_scripts();
+    clear_batches();
 }
 void create(const turret_creation_options_t &turret) noexcept
 {
-    if (!allocator) [[unlikely]] {
+    if (!current_world().turret) [[unlikely]] {
+        LN_ERROR("Attempt to create turret before turret::init() was called.");
+        return;
+    }
+    if (size_t(turret.pattern) >= pattern_count) [[unlikely]] {
+        LN_WARN("Attempt to create turret with invalid pattern");
+        return;
+    }
+
+    turret_batch_t &batch = state().batches[size_t(turret.pattern)];
+    const size_t index = batch.x.size();
+    batch.x.push_back(turret.position.x);
+    batch.y.push_back(turret.position.y);
+    batch.angle.push_back(turret.angle);
+    batch.ready.push_back(0);
+    if (turret.pattern == turret_pattern_e::Tracking) {
+        auto &line_of_sight = state().line_of_sight;
+        line_of_sight.visible.push_back(0);
+        line_of_sight.tested_x.push_back(NAN);
+        line_of_sight.tested_y.push_back(NAN);
+    }
+
+    if (turret.fire_rate <= 0)
+        return;
+    const float period = 1 / turret.fire_rate;
+    state().fire_timers.push_back(timer::start(timer::timer_options_t{
+        .delay = period,
+        .period = period,
+        .callback = mark_ready,
+        .user_data = fire_timer_data(turret.pattern, index),
+    }));
+}
+
+bool create_scripted(lib::vect_t position, float angle,
+                     script_fn script) noexcept
+{
+    if (!current_world().turret) [[unlikely]] {
         LN_ERROR("Attempt to create turret before turret::init() was called.");
+        return false;
+    }
+
+    // the pool never grows, so it's only made once something uses it
+    if (!state().script_frames.has_value())
+        state().script_frames.emplace(max_turret_scripts);
+
+    auto &scripted = state().scripted;
+    const auto index = uint32_t(scripted.x.size());
+    // scripts start suspended, so the turret doesn't need to exist yet. this
+    // way nothing is added if there's no frame for the script.
+    const script_handle_t handle = script(scripted_turret_t(index)).handle;
+    if (!handle) [[unlikely]] {
+        LN_WARN("Failed to start turret script");
+        return false;
+    }
+    scripted.x.push_back(position.x);
+    scripted.y.push_back(position.y);
+    scripted.angle.push_back(angle);
+    scripted.scripts.push_back(handle);
+    // the script may finish during this, which clears its slot
+    handle.resume();
+    return true;
+}
+
+void scripted_turret_t::wait_t::await_suspend(
+    std::coroutine_handle<> script) const noexcept
+{
+    auto handle = script_handle_t::from_address(script.address());
+    handle.promise().wake_timer = timer::start(timer::timer_options_t{
+        .delay = seconds,
+        .callback = resume_script,
+        .user_data = script.address(),
+    });
+}
+
+void scripted_turret_t::fire(uint32_t count, float spread) const noexcept
+{
+    const lib::vect_t origin = position();
+    if (count == 0 || !physics::is_in_active_region(origin))
+        return;
+    auto &shots = state().shots;
+    if (count == 1) {
+        shots.push_back(shot(origin, angle()));
+        return;
+    }
+    const float step = spread / float(count - 1);
+    const float first = angle() - (spread / 2);
+    for (uint32_t i = 0; i < count; ++i) {
+        shots.push_back(shot(origin, first + (step * float(i))));
+    }
+}
+
+void scripted_turret_t::rotate(float radians) const noexcept
+{
+    state().scripted.angle[index] += radians;
+}
+
+void scripted_turret_t::set_angle(float radians) const noexcept
+{
+    state().scripted.angle[index] = radians;
+}
+
+float scripted_turret_t::angle() const noexcept
+{
+    return state().scripted.angle[index];
+}
+
+lib::vect_t scripted_turret_t::position() const noexcept
+{
+    auto &scripted = state().scripted;
+    return {scripted.x[index], scripted.y[index]};
+}
+
+void *script_t::promise_type::operator new(size_t size) noexcept
+{
+    if (size > script_frame_size) [[unlikely]] {
+        LN_ERROR_FMT("Turret script needs a {} byte coroutine frame, which is "
+                     "more than script_frame_size",
+                     size);
+        return nullptr;
+    }
+    auto &frames = state().script_frames.value();
+    auto res = frames.alloc_new();
+    if (!res.okay()) [[unlikely]] {
+        LN_WARN("Too many turret scripts running at once");
+        return nullptr;
+    }
+    return frames.get(res.release()).release().bytes;
+}
+
+void script_t::promise_type::operator delete(void *frame, size_t) noexcept
+{
+    auto &frames = state().script_frames.value();
+    auto handle =
+        frames.get_handle_from_item(static_cast<script_frame_t *>(frame));
+    if (!handle.okay()) [[unlikely]] {
+        LN_ERROR("Attempt to free a turret script frame which did not come "
+                 "from the frame pool");
         return;
     }
+    frames.free(handle.release());
+}
 
-    auto res = allocator.value().alloc_new(turret);
-    if (!res.okay()) {
-        LN_WARN("err allocating turret");
+void script_t::promise_type::return_void() noexcept
+{
+    state().scripted.scripts[turret_index] = {};
+}
+
+namespace scripts {
+script_t burst_and_turn(scripted_turret_t turret)
+{
+    constexpr float pi = std::numbers::pi_v<float>;
+    for (;;) {
+        turret.fire(8, pi / 4);
+        co_await turret.wait(0.5f);
+        turret.rotate(pi / 12);
     }
 }
+} // namespace scripts
+
 } // namespace cw::turret
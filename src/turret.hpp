@@ -1,7 +1,10 @@
 #pragma once
 
+#include "physics.hpp"
+#include "thelib/opt.hpp"
 #include "thelib/vect.hpp"
 #include <cstdint>
+#include <numbers>
 
 namespace cw::turret {
 /// Initialize resources (mainly allocate memory) needed for turret objects
@@ -10,8 +13,35 @@ void init() noexcept;
 void cleanup() noexcept;
 /// Remove all turrets from the level
 void clear_level() noexcept;
-/// Update turrets. should be called every frame
-void update(float dt) noexcept;
+/// Aim Tracking turrets at the target, turn Spiral turrets, and spawn the
+/// bullets of every turret whose fire timer went off since the last call, all
+/// with one bullet::spawn_batch(). Tracking turrets only shoot when they can
+/// see the target, and without a target they keep their last aim and don't
+/// shoot. Call once per fixed step, after timer::update().
+void update(float dt, lib::opt_t<lib::vect_t> target) noexcept;
+
+/// Speed of the bullets fired by turrets
+inline constexpr float bullet_speed = 300;
+
+/// How fast Spiral turrets turn, in radians per second
+inline constexpr float spiral_turn_rate = std::numbers::pi_v<float> / 2;
+
+// Whether a Tracking turret can see the target is cached per turret, and only
+// tested again with a segment query once the target has moved more than
+// line_of_sight_threshold since the last test. Each update() looks at no more
+// than line_of_sight_checks_per_tick turrets and tests at most
+// line_of_sight_queries_per_tick of them, picking up where the last update()
+// stopped, so its cost stays the same no matter how many turrets there are.
+// Turrets never move, so only the target moving makes a result stale.
+
+/// How far the target can move before a turret's line of sight to it is tested
+/// again
+inline constexpr float line_of_sight_threshold = 16;
+inline constexpr size_t line_of_sight_queries_per_tick = 32;
+inline constexpr size_t line_of_sight_checks_per_tick = 256;
+/// The collision types that block a turret's line of sight
+inline constexpr physics::query_filter_t line_of_sight_filter =
+    physics::query_filter({physics::collision_type_e::Obstacle});
 
 enum class turret_pattern_e : uint8_t
 {
@@ -26,8 +56,11 @@ enum class turret_pattern_e : uint8_t
 struct turret_creation_options_t
 {
     lib::vect_t position;
+    /// Shots per second. Turrets with a fire rate of zero never shoot.
     float fire_rate;
     turret_pattern_e pattern;
+    /// Direction of the first shot, in radians
+    float angle = 0;
 };
 
 void create(const turret_creation_options_t &turret) noexcept;
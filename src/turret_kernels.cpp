@@ -0,0 +1,158 @@
+#include "turret_kernels.hpp"
+#include "natural_log/natural_log.hpp"
+#include <cmath>
+#include <cstdlib>
+#include <numbers>
+
+#if defined(__x86_64__) || defined(__i386__)
+#define CROSSWIRE_TURRET_KERNELS_X86
+#include <immintrin.h>
+#endif
+
+using aim_fn = void (*)(const float *x, const float *y, float target_x,
+                        float target_y, float *out_angle,
+                        size_t count) noexcept;
+
+constexpr float half_pi = std::numbers::pi_v<float> / 2;
+constexpr float pi = std::numbers::pi_v<float>;
+
+// coefficients for atan(a) on [0, 1], odd terms only (Abramowitz and Stegun
+// 4.4.49). the error measures around 1.2e-5 in float, which stays inside
+// atan2_max_error.
+constexpr float atan_c1 = 0.9998660f;
+constexpr float atan_c3 = -0.3302995f;
+constexpr float atan_c5 = 0.1801410f;
+constexpr float atan_c7 = -0.0851330f;
+constexpr float atan_c9 = 0.0208351f;
+
+static void aim_scalar(const float *x, const float *y, float target_x,
+                       float target_y, float *out_angle, size_t count) noexcept
+{
+    for (size_t i = 0; i < count; ++i) {
+        out_angle[i] = cw::turret::kernels::fast_atan2(target_y - y[i],
+                                                       target_x - x[i]);
+    }
+}
+
+#ifdef CROSSWIRE_TURRET_KERNELS_X86
+__attribute__((target("sse2"))) static void
+aim_sse2(const float *x, const float *y, float target_x, float target_y,
+         float *out_angle, size_t count) noexcept
+{
+    const __m128 sign_bit = _mm_set1_ps(-0.0f);
+    const __m128 tx = _mm_set1_ps(target_x);
+    const __m128 ty = _mm_set1_ps(target_y);
+    const __m128 smallest = _mm_set1_ps(1e-30f);
+    size_t i = 0;
+    for (; i + 4 <= count; i += 4) {
+        const __m128 dx = _mm_sub_ps(tx, _mm_loadu_ps(x + i));
+        const __m128 dy = _mm_sub_ps(ty, _mm_loadu_ps(y + i));
+        const __m128 abs_x = _mm_andnot_ps(sign_bit, dx);
+        const __m128 abs_y = _mm_andnot_ps(sign_bit, dy);
+        const __m128 big = _mm_max_ps(_mm_max_ps(abs_x, abs_y), smallest);
+        const __m128 a = _mm_div_ps(_mm_min_ps(abs_x, abs_y), big);
+        const __m128 s = _mm_mul_ps(a, a);
+
+        __m128 r = _mm_set1_ps(atan_c9);
+        r = _mm_add_ps(_mm_mul_ps(r, s), _mm_set1_ps(atan_c7));
+        r = _mm_add_ps(_mm_mul_ps(r, s), _mm_set1_ps(atan_c5));
+        r = _mm_add_ps(_mm_mul_ps(r, s), _mm_set1_ps(atan_c3));
+        r = _mm_add_ps(_mm_mul_ps(r, s), _mm_set1_ps(atan_c1));
+        r = _mm_mul_ps(r, a);
+
+        // no blendv before SSE4.1, so select with masks
+        const __m128 steep = _mm_cmpgt_ps(abs_y, abs_x);
+        r = _mm_or_ps(_mm_and_ps(steep, _mm_sub_ps(_mm_set1_ps(half_pi), r)),
+                      _mm_andnot_ps(steep, r));
+        const __m128 left = _mm_cmplt_ps(dx, _mm_setzero_ps());
+        r = _mm_or_ps(_mm_and_ps(left, _mm_sub_ps(_mm_set1_ps(pi), r)),
+                      _mm_andnot_ps(left, r));
+        // copy the sign of dy onto the result
+        r = _mm_or_ps(r, _mm_and_ps(sign_bit, dy));
+        _mm_storeu_ps(out_angle + i, r);
+    }
+    aim_scalar(x + i, y + i, target_x, target_y, out_angle + i, count - i);
+}
+
+__attribute__((target("avx2,fma"))) static void
+aim_avx2(const float *x, const float *y, float target_x, float target_y,
+         float *out_angle, size_t count) noexcept
+{
+    const __m256 sign_bit = _mm256_set1_ps(-0.0f);
+    const __m256 tx = _mm256_set1_ps(target_x);
+    const __m256 ty = _mm256_set1_ps(target_y);
+    const __m256 smallest = _mm256_set1_ps(1e-30f);
+    size_t i = 0;
+    for (; i + 8 <= count; i += 8) {
+        const __m256 dx = _mm256_sub_ps(tx, _mm256_loadu_ps(x + i));
+        const __m256 dy = _mm256_sub_ps(ty, _mm256_loadu_ps(y + i));
+        const __m256 abs_x = _mm256_andnot_ps(sign_bit, dx);
+        const __m256 abs_y = _mm256_andnot_ps(sign_bit, dy);
+        const __m256 big =
+            _mm256_max_ps(_mm256_max_ps(abs_x, abs_y), smallest);
+        const __m256 a = _mm256_div_ps(_mm256_min_ps(abs_x, abs_y), big);
+        const __m256 s = _mm256_mul_ps(a, a);
+
+        __m256 r = _mm256_set1_ps(atan_c9);
+        r = _mm256_fmadd_ps(r, s, _mm256_set1_ps(atan_c7));
+        r = _mm256_fmadd_ps(r, s, _mm256_set1_ps(atan_c5));
+        r = _mm256_fmadd_ps(r, s, _mm256_set1_ps(atan_c3));
+        r = _mm256_fmadd_ps(r, s, _mm256_set1_ps(atan_c1));
+        r = _mm256_mul_ps(r, a);
+
+        r = _mm256_blendv_ps(r, _mm256_sub_ps(_mm256_set1_ps(half_pi), r),
+                             _mm256_cmp_ps(abs_y, abs_x, _CMP_GT_OQ));
+        r = _mm256_blendv_ps(
+            r, _mm256_sub_ps(_mm256_set1_ps(pi), r),
+            _mm256_cmp_ps(dx, _mm256_setzero_ps(), _CMP_LT_OQ));
+        r = _mm256_or_ps(r, _mm256_and_ps(sign_bit, dy));
+        _mm256_storeu_ps(out_angle + i, r);
+    }
+    aim_sse2(x + i, y + i, target_x, target_y, out_angle + i, count - i);
+}
+#endif
+
+static aim_fn select_aim() noexcept
+{
+#ifdef CROSSWIRE_TURRET_KERNELS_X86
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma"))
+        return aim_avx2;
+    if (__builtin_cpu_supports("sse2"))
+        return aim_sse2;
+#endif
+    return aim_scalar;
+}
+
+namespace cw::turret::kernels {
+
+float fast_atan2(float y, float x) noexcept
+{
+    const float abs_x = std::fabs(x);
+    const float abs_y = std::fabs(y);
+    const float big = std::fmax(std::fmax(abs_x, abs_y), 1e-30f);
+    const float a = std::fmin(abs_x, abs_y) / big;
+    const float s = a * a;
+    float r = (((atan_c9 * s + atan_c7) * s + atan_c5) * s + atan_c3) * s +
+              atan_c1;
+    r *= a;
+    if (abs_y > abs_x)
+        r = half_pi - r;
+    if (x < 0)
+        r = pi - r;
+    return std::copysign(r, y);
+}
+
+void aim(lib::slice_t<const float> x, lib::slice_t<const float> y,
+         lib::vect_t target, lib::slice_t<float> out_angle) noexcept
+{
+    static const aim_fn aim_impl = select_aim();
+    const size_t count = x.size();
+    if (y.size() != count || out_angle.size() != count) [[unlikely]] {
+        LN_FATAL("Mismatched array lengths passed to turret::kernels::aim");
+        std::abort();
+    }
+    aim_impl(x.data(), y.data(), target.x, target.y, out_angle.data(), count);
+}
+
+} // namespace cw::turret::kernels
@@ -0,0 +1,22 @@
+#pragma once
+/// Loops over the packed turret arrays, with SSE2 and AVX2 versions chosen at
+/// runtime like the bullet kernels.
+
+#include "thelib/slice.hpp"
+#include "thelib/vect.hpp"
+
+namespace cw::turret::kernels {
+
+/// Largest difference between fast_atan2() and std::atan2(), in radians
+inline constexpr float atan2_max_error = 2e-5f;
+
+/// Polynomial approximation of atan2 that the vector versions of aim() use.
+/// Returns 0 for (0, 0).
+[[nodiscard]] float fast_atan2(float y, float x) noexcept;
+
+/// out_angle[i] = fast_atan2(target.y - y[i], target.x - x[i]). All slices
+/// must be the same length.
+void aim(lib::slice_t<const float> x, lib::slice_t<const float> y,
+         lib::vect_t target, lib::slice_t<float> out_angle) noexcept;
+
+} // namespace cw::turret::kernels
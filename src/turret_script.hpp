@@ -0,0 +1,138 @@
+#pragma once
+/// Turrets driven by C++20 coroutines instead of one of the fixed patterns.
+/// A script is a function returning script_t that takes the turret it
+/// controls, and it runs until its first co_await as soon as the turret is
+/// created. For example:
+///
+///     script_t burst_and_turn(scripted_turret_t turret)
+///     {
+///         for (;;) {
+///             turret.fire(8, pi / 4);
+///             co_await turret.wait(0.5f);
+///             turret.rotate(pi / 12);
+///         }
+///     }
+///
+/// A waiting script is resumed by a timer::update() tick, so waiting scripts
+/// cost nothing per frame. Coroutine frames come from a fixed size pool in the
+/// turret module instead of the heap.
+
+#include "thelib/opt.hpp"
+#include "thelib/vect.hpp"
+#include "timer.hpp"
+#include <coroutine>
+#include <cstdint>
+#include <cstdlib>
+
+namespace cw::turret {
+
+/// Largest coroutine frame a script may have. Scripts which need more than
+/// this (because of big local variables) fail to start.
+inline constexpr size_t script_frame_size = 512;
+
+/// Most scripts that can be running at once in one world
+inline constexpr size_t max_turret_scripts = 4096;
+
+struct script_t;
+
+/// What a script uses to control its turret. Only valid inside of the
+/// script.
+class scripted_turret_t
+{
+  public:
+    /// Suspends the script for some number of seconds, rounded up to whole
+    /// timer ticks
+    struct wait_t
+    {
+        float seconds;
+
+        [[nodiscard]] constexpr bool await_ready() const noexcept
+        {
+            return false;
+        }
+        void await_suspend(std::coroutine_handle<> script) const noexcept;
+        constexpr void await_resume() const noexcept {}
+    };
+
+    /// Fire count bullets spread evenly over an arc of spread radians centered
+    /// on the turret's angle. The bullets are spawned by the next
+    /// turret::update(). Does nothing while the turret is outside of the
+    /// active region.
+    void fire(uint32_t count = 1, float spread = 0) const noexcept;
+    /// Turn the turret by some number of radians
+    void rotate(float radians) const noexcept;
+    void set_angle(float radians) const noexcept;
+    [[nodiscard]] float angle() const noexcept;
+    [[nodiscard]] lib::vect_t position() const noexcept;
+    [[nodiscard]] constexpr wait_t wait(float seconds) const noexcept
+    {
+        return wait_t{.seconds = seconds};
+    }
+
+    /// Do not use this constructor unless you know what you're doing
+    explicit constexpr scripted_turret_t(uint32_t index) noexcept
+        : index(index)
+    {
+    }
+
+  private:
+    friend struct script_t;
+    uint32_t index;
+};
+
+/// Return type of turret scripts
+struct script_t
+{
+    struct promise_type
+    {
+        /// The script's turret, which is always its first argument
+        uint32_t turret_index;
+        /// The timer which will resume the script, while it is waiting
+        lib::opt_t<timer::raw_timer_t> wake_timer;
+
+        explicit promise_type(scripted_turret_t turret) noexcept
+            : turret_index(turret.index)
+        {
+        }
+
+        /// Take a frame from the turret module's pool. Returns null if the
+        /// pool is full or the frame is bigger than script_frame_size.
+        static void *operator new(size_t size) noexcept;
+        static void operator delete(void *frame, size_t size) noexcept;
+        static script_t get_return_object_on_allocation_failure() noexcept
+        {
+            return script_t{};
+        }
+
+        script_t get_return_object() noexcept
+        {
+            return script_t{
+                std::coroutine_handle<promise_type>::from_promise(*this)};
+        }
+        /// Suspended until the turret module has kept track of it
+        std::suspend_always initial_suspend() noexcept { return {}; }
+        /// Finished scripts free their frame right away
+        std::suspend_never final_suspend() noexcept { return {}; }
+        /// Lets the turret module forget about the script
+        void return_void() noexcept;
+        void unhandled_exception() noexcept { std::abort(); }
+    };
+
+    /// Null if the frame could not be allocated
+    std::coroutine_handle<promise_type> handle;
+};
+
+using script_fn = script_t (*)(scripted_turret_t turret);
+
+/// Create a turret controlled by a script, which runs until its first co_await
+/// right away. Returns false if the script could not be started.
+bool create_scripted(lib::vect_t position, float angle,
+                     script_fn script) noexcept;
+
+namespace scripts {
+/// Fire 8 bullets over a quarter turn, wait half a second, turn by 15 degrees,
+/// and repeat
+script_t burst_and_turn(scripted_turret_t turret);
+} // namespace scripts
+
+} // namespace cw::turret
@@ -61,7 +61,14 @@ void wire_t::spawn_tool(lib::vect_t position) {
     }
 }
 bool wire_t::check_wire_validity() {
-    // test for collision between wire and the global static body
-    return true;
+    if (joints.empty())
+        return true;
+    // the wire from the last joint to the player may not pass through obstacles
+    constexpr auto filter =
+        physics::query_filter({physics::collision_type_e::Obstacle});
+    return !physics::query_segment_first(
+                joints.back(), physics::get_body(playerRef->body).position(),
+                0, filter)
+                .has_value();
 }
 }
@@ -0,0 +1,20 @@
+#include "world.hpp"
+
+static cw::world_t default_world;
+static thread_local cw::world_t *this_threads_world = &default_world;
+
+namespace cw {
+
+world_t::~world_t() noexcept
+{
+    if (physics || physics_memory || bullet || terrain || turret || loader ||
+        timer) [[unlikely]] {
+        LN_WARN("World destroyed without cleaning up all of its modules");
+    }
+}
+
+world_t &current_world() noexcept { return *this_threads_world; }
+
+void set_current_world(world_t &world) noexcept { this_threads_world = &world; }
+
+} // namespace cw
@@ -0,0 +1,112 @@
+#pragma once
+#include "natural_log/natural_log.hpp"
+#include "root_allocator.hpp"
+#include <new>
+
+namespace cw {
+
+// each module defines its own state in its translation unit
+namespace physics {
+struct world_state_t;
+}
+namespace physics::memory {
+struct world_state_t;
+}
+namespace bullet {
+struct world_state_t;
+}
+namespace terrain {
+struct world_state_t;
+}
+namespace turret {
+struct world_state_t;
+}
+namespace loader {
+struct world_state_t;
+}
+namespace timer {
+struct world_state_t;
+}
+
+/// Everything that makes up one simulation: the physics space and everything
+/// in it, bullets, terrain, turrets, timers, and the loaded level. A module's
+/// init() creates its part of the current world and its cleanup() destroys it.
+///
+/// Several worlds can exist at once, and separate threads can step separate
+/// worlds, as long as no two threads use the same world at the same time.
+/// The root allocator and the logger are still shared between all worlds, so
+/// those have to be safe to use from several threads before doing that.
+struct world_t
+{
+    physics::world_state_t *physics = nullptr;
+    physics::memory::world_state_t *physics_memory = nullptr;
+    bullet::world_state_t *bullet = nullptr;
+    terrain::world_state_t *terrain = nullptr;
+    turret::world_state_t *turret = nullptr;
+    loader::world_state_t *loader = nullptr;
+    timer::world_state_t *timer = nullptr;
+
+    world_t() noexcept = default;
+    /// Warns if any module was not cleaned up
+    ~world_t() noexcept;
+
+    // modules point into the world, so it can't be copied or moved
+    world_t(const world_t &) = delete;
+    world_t &operator=(const world_t &) = delete;
+    world_t(world_t &&) = delete;
+    world_t &operator=(world_t &&) = delete;
+};
+
+/// The world that module functions called from this thread operate on. Every
+/// thread starts out using the same default world, so single-world code never
+/// needs to call set_current_world().
+[[nodiscard]] world_t &current_world() noexcept;
+
+/// Make module functions called from this thread operate on the given world.
+void set_current_world(world_t &world) noexcept;
+
+/// Get a module's state out of the current world. Aborts if the module's init()
+/// was never called for this world.
+template <typename T>
+[[nodiscard]] inline T &expect_world_state(T *state,
+                                           const char *module_name) noexcept
+{
+    if (!state) [[unlikely]] {
+        LN_FATAL_FMT("The {} module was used in a world where it was not "
+                     "initialized",
+                     module_name);
+        std::abort();
+    }
+    return *state;
+}
+
+/// Allocate and default construct a module's world state. Used by init()
+/// functions.
+template <typename T> [[nodiscard]] inline T *create_world_state() noexcept
+{
+    auto res = root_allocator.alloc(allo::interfaces::AllocationType::Singleton,
+                                    sizeof(T), 1);
+    if (!res.okay()) [[unlikely]] {
+        LN_FATAL("Failed to allocate module state for world");
+        std::abort();
+    }
+    return new (res.release().data()) T();
+}
+
+/// Destroy a module's world state and set the pointer to it to null. Used by
+/// cleanup() functions.
+template <typename T> inline void destroy_world_state(T *&state) noexcept
+{
+    if (!state) [[unlikely]]
+        return;
+    state->~T();
+    auto status = root_allocator.free(
+        allo::interfaces::AllocationType::Singleton, state, sizeof(T));
+    if (!status.okay()) [[unlikely]] {
+        LN_WARN_FMT("Failed to free module state for world with errcode {}",
+                    fmt::underlying(status.status()));
+    }
+    state = nullptr;
+}
+
+} // namespace cw
@@ -0,0 +1,87 @@
+#include "test_header.hpp"
+// test header must be first
+#include "constants/physics.hpp"
+#include "game_ids.hpp"
+#include "natural_log/natural_log.hpp"
+#include "physics.hpp"
+#include "physics_collision_types.hpp"
+
+using namespace cw;
+
+/// A dynamic box resting on a static segment, so that they are touching after
+/// the first step
+struct touching_shapes_t
+{
+    physics::raw_body_t body;
+    physics::raw_poly_shape_t box;
+    physics::raw_segment_shape_t ground;
+
+    touching_shapes_t()
+        : body(physics::create_body(game_id_e::Player,
+                                    {
+                                        .type = lib::body_t::Type::DYNAMIC,
+                                        .mass = 1,
+                                        .moment = INFINITY,
+                                    })),
+          box(physics::create_box_shape(
+              body,
+              {
+                  .collision_type =
+                      cpCollisionType(physics::collision_type_e::Player),
+                  .bounding = lib::rect_t({0, 0}, {10, 10}),
+                  .radius = 1,
+              })),
+          ground(physics::create_segment_shape(
+              physics::get_static_body(),
+              {
+                  .collision_type =
+                      cpCollisionType(physics::collision_type_e::Obstacle),
+                  .a = {-50, 4},
+                  .b = {50, 4},
+                  .radius = 1,
+              }))
+    {
+    }
+};
+
+static size_t count_events(physics::collision_event_type_e type)
+{
+    size_t count = 0;
+    for (const auto &event : physics::collision_events()) {
+        count += event.type == type;
+    }
+    return count;
+}
+
+TEST_SUITE("physics")
+{
+    TEST_CASE("Separate events from deleting shapes between steps")
+    {
+        ln::init();
+        physics::init();
+        touching_shapes_t shapes;
+        physics::update(PHYSICS_TIME_STEP);
+        REQUIRE(count_events(physics::collision_event_type_e::Begin) == 1);
+
+        SUBCASE("deleted right away")
+        {
+            physics::delete_polygon_shape(shapes.box);
+            REQUIRE(count_events(physics::collision_event_type_e::Separate) ==
+                    1);
+        }
+
+        SUBCASE("deletion still deferred when update() runs")
+        {
+            physics::begin_batch();
+            physics::delete_polygon_shape(shapes.box);
+            REQUIRE(count_events(physics::collision_event_type_e::Separate) ==
+                    0);
+            physics::update(PHYSICS_TIME_STEP);
+            physics::end_batch();
+            REQUIRE(count_events(physics::collision_event_type_e::Separate) ==
+                    1);
+        }
+
+        physics::cleanup();
+    }
+}
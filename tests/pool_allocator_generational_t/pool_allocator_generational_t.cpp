@@ -51,6 +51,38 @@ TEST_SUITE("pool_allocator_generational_t")
         {
             tests::pool_that_has_been_added_to_and_removed_from();
         }
+        SUBCASE("reserve() makes room without losing free spots")
+        {
+            using pool = generational<int, tests::c_options>;
+            pool mypool(4);
+
+            auto a = mypool.alloc_new(1).release();
+            auto b = mypool.alloc_new(2).release();
+            auto c = mypool.alloc_new(3).release();
+            REQUIRE(mypool.free(b).okay());
+            REQUIRE(mypool.spots_available() == 2);
+
+            REQUIRE(mypool.reserve(2).okay());
+            REQUIRE(mypool.capacity() == 4);
+
+            REQUIRE(mypool.reserve(100).okay());
+            REQUIRE(mypool.capacity() >= 102);
+            REQUIRE(mypool.spots_available() >= 100);
+            const size_t capacity = mypool.capacity();
+
+            // both the old free spots and the new ones get used, without any
+            // further reallocation
+            size_t sum = 0;
+            for (int i = 0; i < 100; ++i) {
+                auto handle = mypool.alloc_new(i).release();
+                sum += size_t(mypool.get(handle).release());
+            }
+            REQUIRE(mypool.capacity() == capacity);
+            REQUIRE(sum == 4950);
+            REQUIRE(mypool.get(a).release() == 1);
+            REQUIRE(mypool.get(c).release() == 3);
+            REQUIRE(!mypool.get(b).okay());
+        }
     }
     TEST_CASE("optimization")
     {